@@ -29,6 +29,7 @@ endif()
 
 find_dependency(prrng)
 find_dependency(xtensor)
+find_dependency(Threads)
 
 # Define support target "GooseEYE::compiler_warnings"
 
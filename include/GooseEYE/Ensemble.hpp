@@ -23,9 +23,532 @@ inline Ensemble::Ensemble(const std::vector<size_t>& roi, bool periodic, bool va
     m_pad = detail::pad_width(m_shape);
 }
 
+inline void Ensemble::set_threads(size_t nthreads)
+{
+    GOOSEEYE_ASSERT(nthreads > 0, std::out_of_range);
+    m_nthreads = nthreads;
+}
+
+inline void Ensemble::set_autocorrelation(bool autocorrelation)
+{
+    GOOSEEYE_ASSERT(m_stat == Type::Unset, std::out_of_range);
+    m_autocorrelation = autocorrelation;
+
+    if (m_radial) {
+        this->set_bins();
+    }
+}
+
+inline void Ensemble::set_tiles(size_t anchors, size_t rows, size_t cache)
+{
+    GOOSEEYE_REQUIRE(cache > 0, std::out_of_range);
+    m_tiled = true;
+    m_tiles = {anchors, rows};
+    m_cache = cache;
+}
+
+inline void Ensemble::set_radial(const std::vector<double>& h, double width)
+{
+    GOOSEEYE_ASSERT(m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_ASSERT(h.size() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(width > 0, std::out_of_range);
+
+    m_radial = true;
+    m_width = width;
+    m_h = {1.0, 1.0, 1.0};
+
+    for (size_t i = 0; i < h.size(); ++i) {
+        m_h[detail::atleast_3d_axis(h.size(), i)] = h[i];
+    }
+
+    // bins up to the largest distance in the region-of-interest
+    double dmax = 0.0;
+    for (size_t d = 0; d < MAX_DIM; ++d) {
+        dmax += std::pow(static_cast<double>(std::max(m_pad[d][0], m_pad[d][1])) * m_h[d], 2.0);
+    }
+    size_t nbins = static_cast<size_t>(std::floor(std::sqrt(dmax) / m_width)) + 1;
+
+    m_radial_first = xt::zeros<double>({nbins});
+    m_radial_second = xt::zeros<double>({nbins});
+    m_radial_norm = xt::zeros<double>({nbins});
+
+    // all lags are added directly to their bin
+    m_first.resize({0, 0, 0});
+    m_second.resize({0, 0, 0});
+    m_norm.resize({0, 0, 0});
+
+    this->set_bins();
+}
+
+inline void Ensemble::set_bins()
+{
+    size_t nbins = m_radial_first.size();
+    size_t k = 0;
+
+    m_bins.resize(m_shape[0] * m_shape[1] * m_shape[2]);
+
+    for (size_t h = 0; h < m_shape[0]; ++h) {
+        for (size_t i = 0; i < m_shape[1]; ++i) {
+            for (size_t j = 0; j < m_shape[2]; ++j) {
+                std::array<size_t, 3> index = {h, i, j};
+                std::array<size_t, 3> other;
+                bool inside = true;
+                double d = 0.0;
+
+                for (size_t a = 0; a < MAX_DIM; ++a) {
+                    double dx = static_cast<double>(index[a]) - static_cast<double>(m_pad[a][0]);
+                    dx *= m_h[a];
+                    d += dx * dx;
+                    inside = inside && index[a] <= 2 * m_pad[a][0];
+                    other[a] = inside ? 2 * m_pad[a][0] - index[a] : 0;
+                }
+
+                size_t b = static_cast<size_t>(std::floor(std::sqrt(d) / m_width));
+                b = std::min(b, nbins - 1);
+
+                // auto-correlation: the value at "-r" follows from the value at "r"
+                if (m_autocorrelation && detail::stencil::mirrored(index, m_pad)) {
+                    b = 2 * nbins;
+                }
+                else if (m_autocorrelation && inside && detail::stencil::mirrored(other, m_pad)) {
+                    b += nbins;
+                }
+
+                m_bins[k++] = b;
+            }
+        }
+    }
+}
+
+inline void Ensemble::set_accumulator(accumulator type)
+{
+    GOOSEEYE_ASSERT(m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
+
+    m_accumulator = type;
+
+    for (size_t k = 0; k < 3; ++k) {
+        m_counts32[k].resize({0, 0, 0});
+        m_counts64[k].resize({0, 0, 0});
+        if (type == accumulator::uint32) {
+            m_counts32[k] = xt::zeros<uint32_t>(m_shape);
+        }
+        else if (type == accumulator::uint64) {
+            m_counts64[k] = xt::zeros<uint64_t>(m_shape);
+        }
+    }
+
+    // the lags are only counted (in "m_counts_pending") while adding a realization
+    if (type != accumulator::floating) {
+        m_first.resize({0, 0, 0});
+        m_second.resize({0, 0, 0});
+        m_norm.resize({0, 0, 0});
+    }
+    else {
+        m_first = xt::zeros<double>(m_shape);
+        m_second = xt::zeros<double>(m_shape);
+        m_norm = xt::zeros<double>(m_shape);
+    }
+}
+
+template <class S>
+inline detail::stencil::Geometry Ensemble::geometry(const S& shape, bool symmetric) const
+{
+    detail::stencil::Geometry geo =
+        detail::stencil::geometry(shape, m_shape, symmetric, m_nthreads);
+
+    if (m_tiled) {
+        std::array<size_t, 2> tile = detail::stencil::auto_tiles(geo, m_cache);
+        for (size_t i = 0; i < 2; ++i) {
+            geo.tile[i] = m_tiles[i] > 0 ? m_tiles[i] : tile[i];
+        }
+    }
+
+    return geo;
+}
+
+inline void Ensemble::begin_realization()
+{
+    if (m_depth++ > 0) {
+        return;
+    }
+
+    if (m_radial) {
+        for (auto& pending : m_radial_pending) {
+            pending.assign(2 * m_radial_first.size() + 1, 0.0);
+        }
+        return;
+    }
+
+    if (m_accumulator == accumulator::floating) {
+        return;
+    }
+
+    for (auto& pending : m_counts_pending) {
+        pending.assign(m_shape[0] * m_shape[1] * m_shape[2], 0);
+    }
+}
+
+inline void Ensemble::end_realization(bool discard)
+{
+    if (--m_depth > 0) {
+        return;
+    }
+
+    if (m_radial) {
+        if (discard) {
+            return;
+        }
+        std::array<array_type::tensor<double, 1>*, 3> sums = {
+            &m_radial_first, &m_radial_second, &m_radial_norm};
+        size_t nbins = m_radial_first.size();
+        // per bin: the lags that are counted once, and the lags that are counted twice
+        for (size_t k = 0; k < 3; ++k) {
+            for (size_t b = 0; b < nbins; ++b) {
+                sums[k]->flat(b) += m_radial_pending[k][b] + 2.0 * m_radial_pending[k][nbins + b];
+            }
+        }
+        return;
+    }
+
+    if (m_accumulator == accumulator::floating) {
+        return;
+    }
+
+    // the counts fit in the counters (checked while adding, see "accumulate")
+    if (!discard && m_accumulator == accumulator::uint32) {
+        this->add_counts(m_counts32);
+    }
+    else if (!discard && m_accumulator == accumulator::uint64) {
+        this->add_counts(m_counts64);
+    }
+    m_counts_pending = {};
+}
+
+template <class K>
+inline void Ensemble::accumulate(size_t n, const std::array<bool, 3>& moments, K kernel)
+{
+    std::vector<double*> ret(3, nullptr);
+
+    if (m_radial) {
+        for (size_t k = 0; k < 3; ++k) {
+            if (moments[k]) {
+                ret[k] = m_radial_pending[k].data();
+            }
+        }
+        const size_t* bin = m_bins.data();
+        detail::thread::accumulate(
+            m_nthreads,
+            n,
+            m_radial_pending[0].size(),
+            ret,
+            [&](size_t begin, size_t end, const std::vector<double*>& buffers) {
+                kernel(
+                    begin,
+                    end,
+                    detail::output::Bins{buffers[0], bin},
+                    detail::output::Bins{buffers[1], bin},
+                    detail::output::Bins{buffers[2], bin});
+            });
+        return;
+    }
+
+    if (m_accumulator != accumulator::floating) {
+        std::vector<uint64_t*> counts(3, nullptr);
+        for (size_t k = 0; k < 3; ++k) {
+            if (moments[k]) {
+                counts[k] = m_counts_pending[k].data();
+            }
+        }
+        detail::thread::accumulate(
+            m_nthreads,
+            n,
+            m_counts_pending[0].size(),
+            counts,
+            [&](size_t begin, size_t end, const std::vector<uint64_t*>& buffers) {
+                kernel(
+                    begin,
+                    end,
+                    detail::output::Counts{buffers[0]},
+                    detail::output::Counts{buffers[1]},
+                    detail::output::Counts{buffers[2]});
+            });
+        // the realization is discarded if it does not fit in the counters
+        if (m_accumulator == accumulator::uint32) {
+            GOOSEEYE_REQUIRE(this->fits(m_counts32), std::out_of_range);
+        }
+        else {
+            GOOSEEYE_REQUIRE(this->fits(m_counts64), std::out_of_range);
+        }
+        return;
+    }
+
+    std::array<array_type::tensor<double, 3>*, 3> sums = {&m_first, &m_second, &m_norm};
+
+    for (size_t k = 0; k < 3; ++k) {
+        if (moments[k]) {
+            ret[k] = sums[k]->data();
+        }
+    }
+
+    detail::thread::accumulate(
+        m_nthreads,
+        n,
+        m_first.size(),
+        ret,
+        [&](size_t begin, size_t end, const std::vector<double*>& buffers) {
+            kernel(begin, end, buffers[0], buffers[1], buffers[2]);
+        });
+}
+
+template <class R>
+inline bool Ensemble::fits(const std::array<array_type::tensor<R, 3>, 3>& counts) const
+{
+    for (size_t k = 0; k < 3; ++k) {
+        for (size_t i = 0; i < counts[k].size(); ++i) {
+            if (m_counts_pending[k][i] > std::numeric_limits<R>::max() - counts[k].flat(i)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+template <class R>
+inline void Ensemble::add_counts(std::array<array_type::tensor<R, 3>, 3>& counts) const
+{
+    for (size_t k = 0; k < 3; ++k) {
+        for (size_t i = 0; i < counts[k].size(); ++i) {
+            counts[k].flat(i) += static_cast<R>(m_counts_pending[k][i]);
+        }
+    }
+}
+
+template <class R>
+inline bool Ensemble::merge_counts(
+    std::array<array_type::tensor<R, 3>, 3>& counts,
+    const std::array<array_type::tensor<R, 3>, 3>& other)
+{
+    for (size_t k = 0; k < 3; ++k) {
+        for (size_t i = 0; i < counts[k].size(); ++i) {
+            if (other[k].flat(i) > std::numeric_limits<R>::max() - counts[k].flat(i)) {
+                return false;
+            }
+        }
+    }
+
+    for (size_t k = 0; k < 3; ++k) {
+        counts[k] += other[k];
+    }
+
+    return true;
+}
+
+inline void Ensemble::merge(const Ensemble& other)
+{
+    GOOSEEYE_REQUIRE(m_shape_orig == other.m_shape_orig, std::out_of_range);
+    GOOSEEYE_REQUIRE(m_periodic == other.m_periodic, std::out_of_range);
+    GOOSEEYE_REQUIRE(m_variance == other.m_variance, std::out_of_range);
+    GOOSEEYE_REQUIRE(m_autocorrelation == other.m_autocorrelation, std::out_of_range);
+    GOOSEEYE_REQUIRE(m_radial == other.m_radial, std::out_of_range);
+    GOOSEEYE_REQUIRE(m_h == other.m_h && m_width == other.m_width, std::out_of_range);
+    GOOSEEYE_REQUIRE(m_accumulator == other.m_accumulator, std::out_of_range);
+    GOOSEEYE_REQUIRE(
+        m_stat == other.m_stat || m_stat == Type::Unset || other.m_stat == Type::Unset,
+        std::out_of_range);
+    GOOSEEYE_REQUIRE(m_depth == 0 && other.m_depth == 0, std::out_of_range);
+
+    if (other.m_stat == Type::Unset) {
+        return;
+    }
+
+    // lock statistic
+    m_stat = other.m_stat;
+
+    if (m_radial) {
+        m_radial_first += other.m_radial_first;
+        m_radial_second += other.m_radial_second;
+        m_radial_norm += other.m_radial_norm;
+    }
+    else if (m_accumulator == accumulator::uint32) {
+        GOOSEEYE_REQUIRE(merge_counts(m_counts32, other.m_counts32), std::out_of_range);
+    }
+    else if (m_accumulator == accumulator::uint64) {
+        GOOSEEYE_REQUIRE(merge_counts(m_counts64, other.m_counts64), std::out_of_range);
+    }
+    else {
+        m_first += other.m_first;
+        m_second += other.m_second;
+        m_norm += other.m_norm;
+    }
+}
+
+inline Ensemble& Ensemble::operator+=(const Ensemble& other)
+{
+    this->merge(other);
+    return *this;
+}
+
+inline void Ensemble::save(std::ostream& stream) const
+{
+    GOOSEEYE_REQUIRE(m_depth == 0, std::out_of_range);
+
+    // header: format, byte order, and version
+    stream.write("GooseEYE", 8);
+    detail::io::write(stream, detail::io::byte_order);
+    detail::io::write(stream, static_cast<uint32_t>(1));
+
+    // settings
+    std::vector<uint64_t> roi(m_shape_orig.cbegin(), m_shape_orig.cend());
+    detail::io::write(stream, roi.data(), roi.size());
+    detail::io::write(stream, detail::io::encode(STAT_CODES, m_stat));
+    detail::io::write(stream, static_cast<uint8_t>(m_periodic));
+    detail::io::write(stream, static_cast<uint8_t>(m_variance));
+    detail::io::write(stream, static_cast<uint8_t>(m_autocorrelation));
+    detail::io::write(stream, detail::io::encode(ACCUMULATOR_CODES, m_accumulator));
+    detail::io::write(stream, static_cast<uint8_t>(m_radial));
+
+    // raw data
+    if (m_radial) {
+        detail::io::write(stream, m_h.data(), m_h.size());
+        detail::io::write(stream, m_width);
+        detail::io::write(stream, m_radial_first.data(), m_radial_first.size());
+        detail::io::write(stream, m_radial_second.data(), m_radial_second.size());
+        detail::io::write(stream, m_radial_norm.data(), m_radial_norm.size());
+    }
+    else if (m_accumulator == accumulator::uint32) {
+        for (auto& counts : m_counts32) {
+            detail::io::write(stream, counts.data(), counts.size());
+        }
+    }
+    else if (m_accumulator == accumulator::uint64) {
+        for (auto& counts : m_counts64) {
+            detail::io::write(stream, counts.data(), counts.size());
+        }
+    }
+    else {
+        detail::io::write(stream, m_first.data(), m_first.size());
+        detail::io::write(stream, m_second.data(), m_second.size());
+        detail::io::write(stream, m_norm.data(), m_norm.size());
+    }
+
+    GOOSEEYE_REQUIRE(stream, std::runtime_error);
+}
+
+inline void Ensemble::save(const std::string& filename) const
+{
+    std::ofstream stream(filename, std::ios::binary);
+    GOOSEEYE_REQUIRE(stream, std::runtime_error);
+    this->save(stream);
+}
+
+inline Ensemble Ensemble::load(std::istream& stream)
+{
+    // header: format, byte order, and version
+    std::array<char, 8> format = detail::io::read<std::array<char, 8>>(stream);
+    GOOSEEYE_REQUIRE(std::string(format.data(), 8) == "GooseEYE", std::runtime_error);
+    uint32_t byte_order = detail::io::read<uint32_t>(stream);
+    GOOSEEYE_REQUIRE(byte_order == detail::io::byte_order, std::runtime_error);
+    GOOSEEYE_REQUIRE(detail::io::read<uint32_t>(stream) == 1, std::runtime_error);
+
+    // settings
+    std::vector<uint64_t> roi = detail::io::read_vector<uint64_t>(stream);
+    GOOSEEYE_REQUIRE(roi.size() <= MAX_DIM, std::runtime_error);
+    Type stat = detail::io::decode(STAT_CODES, detail::io::read<uint8_t>(stream));
+    bool periodic = detail::io::read<uint8_t>(stream) != 0;
+    bool variance = detail::io::read<uint8_t>(stream) != 0;
+    bool autocorrelation = detail::io::read<uint8_t>(stream) != 0;
+    accumulator type = detail::io::decode(ACCUMULATOR_CODES, detail::io::read<uint8_t>(stream));
+    bool radial = detail::io::read<uint8_t>(stream) != 0;
+    GOOSEEYE_REQUIRE(!radial || type == accumulator::floating, std::runtime_error);
+
+    Ensemble ret(std::vector<size_t>(roi.cbegin(), roi.cend()), periodic, variance);
+    ret.set_accumulator(type);
+    ret.set_autocorrelation(autocorrelation);
+
+    // raw data
+    if (radial) {
+        // the bins follow from the settings (as "set_radial")
+        std::array<double, 3> h;
+        detail::io::read(stream, h.data(), h.size());
+        double width = detail::io::read<double>(stream);
+        GOOSEEYE_REQUIRE(width > 0, std::runtime_error);
+        std::vector<double> h_orig(roi.size());
+        for (size_t i = 0; i < roi.size(); ++i) {
+            h_orig[i] = h[detail::atleast_3d_axis(roi.size(), i)];
+        }
+        ret.set_radial(h_orig, width);
+        size_t nbins = ret.m_radial_first.size();
+        detail::io::read(stream, ret.m_radial_first.data(), nbins);
+        detail::io::read(stream, ret.m_radial_second.data(), nbins);
+        detail::io::read(stream, ret.m_radial_norm.data(), nbins);
+    }
+    else if (ret.m_accumulator == accumulator::uint32) {
+        for (auto& counts : ret.m_counts32) {
+            detail::io::read(stream, counts.data(), counts.size());
+        }
+    }
+    else if (ret.m_accumulator == accumulator::uint64) {
+        for (auto& counts : ret.m_counts64) {
+            detail::io::read(stream, counts.data(), counts.size());
+        }
+    }
+    else {
+        detail::io::read(stream, ret.m_first.data(), ret.m_first.size());
+        detail::io::read(stream, ret.m_second.data(), ret.m_second.size());
+        detail::io::read(stream, ret.m_norm.data(), ret.m_norm.size());
+    }
+
+    ret.m_stat = stat;
+
+    return ret;
+}
+
+inline Ensemble Ensemble::load(const std::string& filename)
+{
+    std::ifstream stream(filename, std::ios::binary);
+    GOOSEEYE_REQUIRE(stream, std::runtime_error);
+    return Ensemble::load(stream);
+}
+
+inline array_type::tensor<double, 3> Ensemble::raw(size_t moment) const
+{
+    array_type::tensor<double, 3> ret;
+
+    if (m_accumulator == accumulator::uint32) {
+        ret = xt::cast<double>(m_counts32[moment]);
+    }
+    else if (m_accumulator == accumulator::uint64) {
+        ret = xt::cast<double>(m_counts64[moment]);
+    }
+    else {
+        std::array<const array_type::tensor<double, 3>*, 3> sums = {&m_first, &m_second, &m_norm};
+        ret = *sums[moment];
+    }
+
+    return this->mirrored(ret);
+}
+
+inline array_type::tensor<double, 3>
+Ensemble::mirrored(const array_type::tensor<double, 3>& a) const
+{
+    array_type::tensor<double, 3> ret = a;
+
+    if (m_autocorrelation) {
+        detail::stencil::mirror(ret, m_pad);
+    }
+
+    return ret;
+}
+
 inline array_type::array<double> Ensemble::result() const
 {
-    array_type::array<double> ret = m_first / xt::where(m_norm <= 0, 1.0, m_norm);
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
+
+    array_type::tensor<double, 3> norm = this->raw(2);
+    array_type::array<double> ret = this->raw(0) / xt::where(norm <= 0, 1.0, norm);
 
     if (m_stat == Type::heightheight) {
         ret = xt::pow(ret, 0.5);
@@ -36,35 +559,97 @@ inline array_type::array<double> Ensemble::result() const
 
 inline array_type::array<double> Ensemble::variance() const
 {
-    array_type::tensor<double, 3> norm = xt::where(m_norm <= 0, 1.0, m_norm);
-    array_type::array<double> ret =
-        (m_second / norm - xt::pow(m_first / norm, 2.0)) * norm / (norm - 1);
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
+
+    // fewer than two samples: no estimate of the spread (zero)
+    array_type::tensor<double, 3> norm = this->raw(2);
+    array_type::tensor<bool, 3> few = norm <= 1;
+    norm = xt::where(few, 2.0, norm);
+    array_type::array<double> ret = xt::where(
+        few, 0.0, (this->raw(1) / norm - xt::pow(this->raw(0) / norm, 2.0)) * norm / (norm - 1));
 
     if (m_stat == Type::heightheight) {
         ret = xt::pow(ret, 0.5);
     }
-    else if (m_stat != Type::mean) {
+    else if (m_stat != Type::mean && m_stat != Type::S2_sampled) {
         throw std::runtime_error("Not implemented");
     }
 
     return ret.reshape(m_shape_orig);
 }
 
+inline array_type::array<double> Ensemble::standard_error() const
+{
+    GOOSEEYE_ASSERT(m_stat == Type::S2_sampled, std::out_of_range);
+
+    array_type::array<double> norm = this->norm();
+    return xt::sqrt(this->variance() / xt::where(norm <= 0, 1.0, norm));
+}
+
+inline array_type::array<double> Ensemble::result_radial() const
+{
+    GOOSEEYE_ASSERT(m_radial, std::out_of_range);
+
+    array_type::array<double> ret =
+        m_radial_first / xt::where(m_radial_norm <= 0, 1.0, m_radial_norm);
+
+    if (m_stat == Type::heightheight) {
+        ret = xt::pow(ret, 0.5);
+    }
+
+    return ret;
+}
+
+inline array_type::array<double> Ensemble::variance_radial() const
+{
+    GOOSEEYE_ASSERT(m_radial, std::out_of_range);
+
+    // fewer than two samples: no estimate of the spread (zero)
+    array_type::tensor<bool, 1> few = m_radial_norm <= 1;
+    array_type::tensor<double, 1> norm = xt::where(few, 2.0, m_radial_norm);
+    array_type::tensor<double, 1> mean = m_radial_first / norm;
+    array_type::array<double> ret =
+        xt::where(few, 0.0, (m_radial_second / norm - xt::pow(mean, 2.0)) * norm / (norm - 1));
+
+    if (m_stat == Type::heightheight) {
+        ret = xt::pow(ret, 0.5);
+    }
+    else {
+        throw std::runtime_error("Not implemented");
+    }
+
+    return ret;
+}
+
+inline array_type::array<double> Ensemble::distance_radial() const
+{
+    GOOSEEYE_ASSERT(m_radial, std::out_of_range);
+
+    array_type::array<double> ret = (xt::arange<double>(m_radial_first.size()) + 0.5) * m_width;
+    return ret;
+}
+
 inline array_type::array<double> Ensemble::data_first() const
 {
-    array_type::array<double> ret = m_first;
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
+
+    array_type::array<double> ret = this->raw(0);
     return ret.reshape(m_shape_orig);
 }
 
 inline array_type::array<double> Ensemble::data_second() const
 {
-    array_type::array<double> ret = m_second;
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
+
+    array_type::array<double> ret = this->raw(1);
     return ret.reshape(m_shape_orig);
 }
 
 inline array_type::array<double> Ensemble::norm() const
 {
-    array_type::array<double> ret = m_norm;
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
+
+    array_type::array<double> ret = this->raw(2);
     return ret.reshape(m_shape_orig);
 }
 
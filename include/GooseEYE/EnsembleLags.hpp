@@ -0,0 +1,246 @@
+/**
+ * @file
+ * @copyright Copyright 2017. Tom de Geus. All rights reserved.
+ * @license This project is released under the GPLv3 License.
+ */
+
+#ifndef GOOSEEYE_ENSEMBLELAGS_HPP
+#define GOOSEEYE_ENSEMBLELAGS_HPP
+
+#include "GooseEYE.h"
+
+namespace GooseEYE {
+
+inline EnsembleLags::EnsembleLags(const array_type::tensor<ptrdiff_t, 2>& lags, bool periodic)
+    : m_periodic(periodic), m_lags_orig(lags)
+{
+    size_t ndim = lags.shape(1);
+    GOOSEEYE_ASSERT(ndim >= 1 && ndim <= 3, std::out_of_range);
+
+    // axes of the 3d image along which the image of "ndim" dimensions runs (see "xt::atleast_3d")
+    std::vector<size_t> axes = {0, 1, 2};
+    if (ndim == 1) {
+        axes = {1};
+    }
+
+    m_lags = xt::zeros<ptrdiff_t>({lags.shape(0), size_t(3)});
+
+    for (size_t k = 0; k < lags.shape(0); ++k) {
+        for (size_t d = 0; d < ndim; ++d) {
+            m_lags(k, axes[d]) = lags(k, d);
+        }
+    }
+
+    m_pad = detail::stencil::pad_width_lags(m_lags);
+    m_first = xt::zeros<double>({lags.shape(0)});
+    m_norm = xt::zeros<double>({lags.shape(0)});
+}
+
+inline void EnsembleLags::set_threads(size_t nthreads)
+{
+    GOOSEEYE_ASSERT(nthreads > 0, std::out_of_range);
+    m_nthreads = nthreads;
+}
+
+inline array_type::tensor<ptrdiff_t, 2> EnsembleLags::lags() const
+{
+    return m_lags_orig;
+}
+
+inline array_type::tensor<double, 1> EnsembleLags::result() const
+{
+    return m_first / xt::where(m_norm <= 0, 1.0, m_norm);
+}
+
+inline array_type::tensor<double, 1> EnsembleLags::data_first() const
+{
+    return m_first;
+}
+
+inline array_type::tensor<double, 1> EnsembleLags::norm() const
+{
+    return m_norm;
+}
+
+template <class T, class M>
+inline void EnsembleLags::S2(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using value_type = typename T::value_type;
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_lags_orig.shape(1), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): mask padded items
+    xt::pad_mode pad_mode = xt::pad_mode::constant;
+    int mask_value = 1;
+
+    // periodic: unmask padded items
+    if (m_periodic) {
+        pad_mode = xt::pad_mode::periodic;
+        mask_value = 0;
+    }
+
+    // anchors
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<mask_type, 3> Fmask = xt::atleast_3d(fmask);
+
+    // comparison: apply padding (in the type of the image)
+    array_type::tensor<uint8_t, 3> Gmii =
+        1 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode) * Gmii;
+
+    // compute correlation
+    detail::stencil::Geometry geo =
+        detail::stencil::geometry_lags(F.shape(), m_lags, m_pad, m_nthreads);
+    detail::thread::accumulate(
+        m_nthreads,
+        geo.chunks(),
+        m_first.size(),
+        {m_first.data(), m_norm.data()},
+        [&](size_t begin, size_t end, const std::vector<double*>& ret) {
+            detail::stencil::S2(
+                geo, begin, end, F.data(), Fmask.data(), G.data(), Gmii.data(), ret[0], ret[1]);
+        });
+}
+
+template <class T>
+inline void EnsembleLags::S2(const T& f, const T& g)
+{
+    using value_type = typename T::value_type;
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_lags_orig.shape(1), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): the padded items are skipped
+    // periodic: the padded items are periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // anchors, and padded comparison (no masks)
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+
+    // compute correlation (first moment only)
+    detail::stencil::Geometry geo =
+        detail::stencil::geometry_lags(F.shape(), m_lags, m_pad, m_nthreads);
+    detail::thread::accumulate(
+        m_nthreads,
+        geo.chunks(),
+        m_first.size(),
+        {m_first.data()},
+        [&](size_t begin, size_t end, const std::vector<double*>& ret) {
+            detail::stencil::S2(geo, m_periodic, begin, end, F.data(), G.data(), ret[0]);
+        });
+
+    // normalisation: analytical without masks
+    detail::add_overlap_lags(F.shape(), m_lags, m_periodic, m_norm);
+}
+
+template <class T, class M>
+inline void EnsembleLags::C2(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using value_type = typename T::value_type;
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<value_type>::value, "Integral image required.");
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_lags_orig.shape(1), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::C2 || m_stat == Type::Unset, std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::C2;
+
+    // not periodic (default): mask padded items
+    xt::pad_mode pad_mode = xt::pad_mode::constant;
+    int mask_value = 1;
+
+    // periodic: unmask padded items
+    if (m_periodic) {
+        pad_mode = xt::pad_mode::periodic;
+        mask_value = 0;
+    }
+
+    // anchors
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<mask_type, 3> Fmask = xt::atleast_3d(fmask);
+
+    // comparison: apply padding
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+    array_type::tensor<uint8_t, 3> Gmii =
+        1 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+
+    // compute correlation
+    detail::stencil::Geometry geo =
+        detail::stencil::geometry_lags(F.shape(), m_lags, m_pad, m_nthreads);
+    detail::thread::accumulate(
+        m_nthreads,
+        geo.chunks(),
+        m_first.size(),
+        {m_first.data(), m_norm.data()},
+        [&](size_t begin, size_t end, const std::vector<double*>& ret) {
+            detail::stencil::C2(
+                geo, begin, end, F.data(), Fmask.data(), G.data(), Gmii.data(), ret[0], ret[1]);
+        });
+}
+
+template <class T>
+inline void EnsembleLags::C2(const T& f, const T& g)
+{
+    using value_type = typename T::value_type;
+
+    static_assert(std::is_integral<value_type>::value, "Integral image required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_lags_orig.shape(1), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::C2 || m_stat == Type::Unset, std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::C2;
+
+    // not periodic (default): the padded items are skipped
+    // periodic: the padded items are periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // anchors, and padded comparison (no masks)
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+
+    // compute correlation (first moment only)
+    detail::stencil::Geometry geo =
+        detail::stencil::geometry_lags(F.shape(), m_lags, m_pad, m_nthreads);
+    detail::thread::accumulate(
+        m_nthreads,
+        geo.chunks(),
+        m_first.size(),
+        {m_first.data()},
+        [&](size_t begin, size_t end, const std::vector<double*>& ret) {
+            detail::stencil::C2(geo, m_periodic, begin, end, F.data(), G.data(), ret[0]);
+        });
+
+    // normalisation: analytical without masks
+    detail::add_overlap_lags(F.shape(), m_lags, m_periodic, m_norm);
+}
+
+} // namespace GooseEYE
+
+#endif
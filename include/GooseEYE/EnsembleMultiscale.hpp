@@ -0,0 +1,166 @@
+/**
+ * @file
+ * @copyright Copyright 2017. Tom de Geus. All rights reserved.
+ * @license This project is released under the GPLv3 License.
+ */
+
+#ifndef GOOSEEYE_ENSEMBLEMULTISCALE_HPP
+#define GOOSEEYE_ENSEMBLEMULTISCALE_HPP
+
+#include "GooseEYE.h"
+
+namespace GooseEYE {
+
+inline EnsembleMultiscale::EnsembleMultiscale(
+    const std::vector<size_t>& roi,
+    size_t levels,
+    bool periodic)
+    : m_ndim(roi.size()), m_periodic(periodic)
+{
+    GOOSEEYE_ASSERT(m_ndim >= 1 && m_ndim <= 3, std::out_of_range);
+    GOOSEEYE_ASSERT(levels >= 1, std::out_of_range);
+
+    // 3d equivalent of "roi" (as "xt::atleast_3d"), and the axes along which "roi" runs
+    std::vector<size_t> shape = {1, 1, 1};
+    std::vector<size_t> axes = {0, 1, 2};
+    if (m_ndim == 1) {
+        axes = {1};
+    }
+    for (size_t d = 0; d < m_ndim; ++d) {
+        shape[axes[d]] = roi[d];
+    }
+    std::vector<std::vector<size_t>> pad = detail::pad_width(shape);
+
+    std::vector<ptrdiff_t> lags;
+    std::vector<size_t> level;
+
+    for (size_t l = 0; l < levels; ++l) {
+        std::vector<ptrdiff_t> coarse;
+        for (size_t h = 0; h < shape[0]; ++h) {
+            for (size_t i = 0; i < shape[1]; ++i) {
+                for (size_t j = 0; j < shape[2]; ++j) {
+                    std::array<size_t, 3> index = {h, i, j};
+                    std::array<ptrdiff_t, 3> d;
+                    bool covered = l > 0;
+                    for (size_t k = 0; k < 3; ++k) {
+                        d[k] = static_cast<ptrdiff_t>(index[k]) - static_cast<ptrdiff_t>(pad[k][0]);
+                        if (2 * d[k] < -static_cast<ptrdiff_t>(pad[k][0]) ||
+                            2 * d[k] > static_cast<ptrdiff_t>(pad[k][1])) {
+                            covered = false;
+                        }
+                    }
+                    // skip lags that are computed at the previous (finer) level
+                    if (covered) {
+                        continue;
+                    }
+                    coarse.insert(coarse.end(), d.begin(), d.end());
+                    for (size_t k = 0; k < m_ndim; ++k) {
+                        lags.push_back(d[axes[k]] * (ptrdiff_t(1) << l));
+                    }
+                    level.push_back(l);
+                }
+            }
+        }
+        std::array<size_t, 2> coarse_shape = {coarse.size() / 3, 3};
+        array_type::tensor<ptrdiff_t, 2> coarse_lags = xt::adapt(coarse, coarse_shape);
+        m_levels.emplace_back(coarse_lags, periodic);
+    }
+
+    std::array<size_t, 2> lags_shape = {level.size(), m_ndim};
+    m_lags = xt::adapt(lags, lags_shape);
+    m_level = xt::adapt(level, std::array<size_t, 1>{level.size()});
+}
+
+inline void EnsembleMultiscale::set_threads(size_t nthreads)
+{
+    for (auto& level : m_levels) {
+        level.set_threads(nthreads);
+    }
+}
+
+inline array_type::tensor<ptrdiff_t, 2> EnsembleMultiscale::lags() const
+{
+    return m_lags;
+}
+
+inline array_type::tensor<size_t, 1> EnsembleMultiscale::level() const
+{
+    return m_level;
+}
+
+template <class F>
+inline array_type::tensor<double, 1> EnsembleMultiscale::concatenate(F func) const
+{
+    array_type::tensor<double, 1> ret = xt::empty<double>({m_level.size()});
+    size_t k = 0;
+
+    for (auto& level : m_levels) {
+        array_type::tensor<double, 1> a = func(level);
+        std::copy(a.cbegin(), a.cend(), ret.begin() + k);
+        k += a.size();
+    }
+
+    return ret;
+}
+
+inline array_type::tensor<double, 1> EnsembleMultiscale::result() const
+{
+    return concatenate([](const EnsembleLags& level) { return level.result(); });
+}
+
+inline array_type::tensor<double, 1> EnsembleMultiscale::data_first() const
+{
+    return concatenate([](const EnsembleLags& level) { return level.data_first(); });
+}
+
+inline array_type::tensor<double, 1> EnsembleMultiscale::norm() const
+{
+    return concatenate([](const EnsembleLags& level) { return level.norm(); });
+}
+
+template <class T, class M>
+inline void EnsembleMultiscale::S2(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_ndim, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+
+    // periodic: the blocks of each level have to tile the image,
+    // such that each coarse image is periodic (and not a periodic copy of a partial block)
+    size_t factor = size_t(1) << (m_levels.size() - 1);
+    for (size_t d = 0; d < f.dimension(); ++d) {
+        GOOSEEYE_REQUIRE(
+            !m_periodic || f.shape(d) == 1 || f.shape(d) % factor == 0, std::out_of_range);
+    }
+
+    array_type::tensor<double, 3> F = xt::atleast_3d(f);
+    array_type::tensor<double, 3> G = xt::atleast_3d(g);
+    array_type::tensor<int, 3> Fmask = xt::atleast_3d(fmask);
+    array_type::tensor<int, 3> Gmask = xt::atleast_3d(gmask);
+
+    for (size_t l = 0; l < m_levels.size(); ++l) {
+        if (l > 0) {
+            detail::coarsen(F, Fmask);
+            detail::coarsen(G, Gmask);
+        }
+        m_levels[l].S2(F, G, Fmask, Gmask);
+    }
+}
+
+template <class T>
+inline void EnsembleMultiscale::S2(const T& f, const T& g)
+{
+    array_type::array<int> mask = xt::zeros<int>(f.shape());
+    S2(f, g, mask, mask);
+}
+
+} // namespace GooseEYE
+
+#endif
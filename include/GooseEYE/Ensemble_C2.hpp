@@ -12,7 +12,8 @@
 namespace GooseEYE {
 
 template <class T, class M>
-inline void Ensemble::C2(const T& f, const T& g, const M& fmask, const M& gmask)
+inline void
+Ensemble::C2(const T& f, const T& g, const M& fmask, const M& gmask, compute_mode mode)
 {
     using value_type = typename T::value_type;
     using mask_type = typename M::value_type;
@@ -27,6 +28,23 @@ inline void Ensemble::C2(const T& f, const T& g, const M& fmask, const M& gmask)
     GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::C2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(fmask, gmask)), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+    GOOSEEYE_REQUIRE(mode != compute_mode::sparse, std::out_of_range);
+    GOOSEEYE_REQUIRE(mode != compute_mode::binary, std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode == compute_mode::fft) {
+        C2_fft(f, g, fmask, gmask);
+        return;
+    }
+
+    if (mode == compute_mode::unpadded) {
+        C2_unpadded(f, g, fmask, gmask);
+        return;
+    }
 
     // lock statistic
     m_stat = Type::C2;
@@ -41,50 +59,370 @@ inline void Ensemble::C2(const T& f, const T& g, const M& fmask, const M& gmask)
         mask_value = 0;
     }
 
-    // apply padding
-    array_type::tensor<value_type, 3> F = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
+    // anchors
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<mask_type, 3> Fmask = xt::atleast_3d(fmask);
+
+    // comparison: apply padding
     array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
-    array_type::tensor<mask_type, 3> Fmask =
-        xt::pad(xt::atleast_3d(fmask), m_pad, xt::pad_mode::constant, mask_value);
-    array_type::tensor<double, 3> Gmask =
-        xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    array_type::tensor<uint8_t, 3> Gmii =
+        1 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
 
     // compute correlation
-    for (size_t h = m_pad[0][0]; h < F.shape(0) - m_pad[0][1]; ++h) {
-        for (size_t i = m_pad[1][0]; i < F.shape(1) - m_pad[1][1]; ++i) {
-            for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
-                // - skip masked
-                if (Fmask(h, i, j)) {
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::stencil::C2(
+                geo, begin, end, F.data(), Fmask.data(), G.data(), Gmii.data(), first, norm);
+        });
+}
+
+template <class T>
+inline void Ensemble::C2(const T& f, const T& g, compute_mode mode)
+{
+    using value_type = typename T::value_type;
+
+    static_assert(std::is_integral<value_type>::value, "Integral image required.");
+
+    if (mode != compute_mode::direct) {
+        array_type::array<int> mask = xt::zeros<int>(f.shape());
+        C2(f, g, mask, mask, mode);
+        return;
+    }
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::C2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::C2;
+
+    // not periodic (default): the padded items are skipped
+    // periodic: the padded items are periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // anchors, and padded comparison (no masks)
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+
+    // compute correlation (first moment only)
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto) {
+            detail::stencil::C2(geo, m_periodic, begin, end, F.data(), G.data(), first);
+        });
+
+    // normalisation: analytical without masks
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::add_overlap(F.shape(), m_pad, m_periodic, norm);
+    });
+}
+
+template <class T>
+inline void Ensemble::C2(
+    const T& f,
+    const T& g,
+    const PackedMask& fmask,
+    const PackedMask& gmask,
+    compute_mode mode)
+{
+    using value_type = typename T::value_type;
+
+    static_assert(std::is_integral<value_type>::value, "Integral image required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::C2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || fmask.data() == gmask.data(), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !fmask.any(), std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode != compute_mode::direct) {
+        C2(f, g, fmask.unpack(), gmask.unpack(), mode);
+        return;
+    }
+
+    // lock statistic
+    m_stat = Type::C2;
+
+    // not periodic (default): pad with zeros
+    // periodic: pad with periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // inverse of the masks (packed along the last axis with extent, see "binary::roll"):
+    // anchors, and padded comparison
+    std::array<size_t, 3> shape = detail::shape_3d(f.shape());
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        padded[d] = shape[d] + m_pad[d][0] + m_pad[d][1];
+    }
+    size_t n = detail::binary::shift(shape, m_shape);
+    auto fmii = [&](size_t h, size_t i, size_t j) -> bool { return !fmask(h, i, j); };
+    auto gmasked = [&](size_t h, size_t i, size_t j) -> bool { return gmask(h, i, j); };
+    std::vector<detail::binary::word> Fmii =
+        detail::binary::pack(detail::binary::roll(shape, n), detail::binary::unroll(n, fmii));
+    std::vector<detail::binary::word> Gmii =
+        detail::binary::pack_inverse(shape, m_pad, m_periodic, n, gmasked);
+
+    // anchors, and padded comparison: masked items are set to zero
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+    detail::binary::apply(Fmii, detail::binary::roll(shape, n), F.data());
+    detail::binary::apply(Gmii, detail::binary::roll(padded, n), G.data());
+
+    // compute correlation (first moment only):
+    // masked items do not contribute, such that the loop does not need the masks
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto) {
+            detail::stencil::C2(geo, true, begin, end, F.data(), G.data(), first);
+        });
+
+    // normalisation: count co-occurrences of non-masked items
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::binary::correlate(
+            Fmii, Gmii, detail::binary::roll(shape, n), detail::binary::roll(m_shape, n), norm);
+    });
+}
+
+template <class T, class M>
+inline void
+Ensemble::C2_batch(const T& f, const T& g, const M& fmask, const M& gmask, compute_mode mode)
+{
+    using value_type = typename T::value_type;
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<value_type>::value, "Integral image required.");
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size() + 1, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::C2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(fmask, gmask)), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+    GOOSEEYE_REQUIRE(mode != compute_mode::sparse, std::out_of_range);
+    GOOSEEYE_REQUIRE(mode != compute_mode::binary, std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode == compute_mode::unpadded) {
+        for (size_t s = 0; s < f.shape(0); ++s) {
+            C2_unpadded(xt::view(f, s), xt::view(g, s), xt::view(fmask, s), xt::view(gmask, s));
+        }
+        return;
+    }
+
+    // lock statistic
+    m_stat = Type::C2;
+
+    // not periodic (default): mask padded items
+    // periodic: unmask padded items
+    int mask_value = m_periodic ? 0 : 1;
+    bool fft = mode == compute_mode::fft;
+
+    // shape of one sample, and of one padded sample
+    std::array<size_t, 3> shape = detail::sample_shape(f.shape());
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        padded[d] = shape[d] + m_pad[d][0] + m_pad[d][1];
+    }
+
+    // geometry or transforms, shared by all samples
+    detail::stencil::Geometry geo = geometry(shape, m_autocorrelation);
+    detail::fft::Plan3 plan;
+    if (fft) {
+        plan = detail::fft::plan(detail::fft::padded_shape(shape, m_pad));
+    }
+
+    // distribute the samples over the threads
+    // N.B. the buffers are allocated once per thread (as "xt::xtensor", not to need Python)
+    this->accumulate(
+        f.shape(0),
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            xt::xtensor<value_type, 3> F = xt::empty<value_type>(shape);
+            xt::xtensor<mask_type, 3> Fmask = xt::empty<mask_type>(shape);
+            xt::xtensor<value_type, 3> G = xt::empty<value_type>(padded);
+            xt::xtensor<uint8_t, 3> Gmii = xt::empty<uint8_t>(padded);
+            xt::xtensor<double, 3> Fmii;
+            xt::xtensor<double, 3> Fi;
+            xt::xtensor<double, 3> Gi;
+            std::vector<value_type> labels;
+
+            for (size_t s = begin; s < end; ++s) {
+
+                // anchors
+                xt::noalias(F) = xt::atleast_3d(xt::view(f, s));
+                xt::noalias(Fmask) = xt::atleast_3d(xt::view(fmask, s));
+
+                // comparison: apply padding (as the direct loop)
+                auto Gs = xt::atleast_3d(xt::view(g, s));
+                auto Gmask = xt::atleast_3d(xt::view(gmask, s));
+                detail::pad_into(Gmask, m_pad, false, mask_value, Gmii);
+                detail::pad_into(Gs, m_pad, m_periodic, 0, G);
+                xt::noalias(Gmii) = 1 - Gmii;
+
+                // labels of the anchors (the direct loop skips "f == 0")
+                labels.clear();
+                if (fft) {
+                    Fmii = 1.0 - Fmask;
+                    for (size_t i = 0; i < F.size(); ++i) {
+                        if (F.flat(i) != 0 && Fmii.flat(i) > 0) {
+                            labels.push_back(F.flat(i));
+                        }
+                    }
+                    std::sort(labels.begin(), labels.end());
+                    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+                }
+
+                // one correlation per label: for many labels the direct loop is faster
+                if (!fft || !detail::fft::faster(labels.size() + 1, shape, m_pad)) {
+                    detail::stencil::C2(
+                        geo,
+                        0,
+                        geo.chunks(),
+                        F.data(),
+                        Fmask.data(),
+                        G.data(),
+                        Gmii.data(),
+                        first,
+                        norm);
                     continue;
                 }
-                // - get comparison sub-matrix
-                auto Gi = xt::view(
-                    G,
-                    xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                    xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                    xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - get inverse of comparison mask
-                auto Gmii = 1.0 - xt::view(
-                                      Gmask,
-                                      xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                                      xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                                      xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - correlation (account for mask)
-                if (F(h, i, j) != 0) {
-                    m_first += xt::where(xt::equal(F(h, i, j), Gi), Gmii, 0.0);
+
+                for (auto& label : labels) {
+                    Fi = xt::where(xt::equal(F, label), Fmii, 0.0);
+                    Gi = xt::where(xt::equal(G, label), xt::cast<double>(Gmii), 0.0);
+                    detail::fft::add_correlation(Fi, Gi, m_pad, plan, first, true);
                 }
-                // - normalisation
-                m_norm += Gmii;
+
+                detail::fft::add_correlation(Fmii, Gmii, m_pad, plan, norm, true);
             }
-        }
-    }
+        });
 }
 
 template <class T>
-inline void Ensemble::C2(const T& f, const T& g)
+inline void Ensemble::C2_batch(const T& f, const T& g, compute_mode mode)
 {
     array_type::array<int> mask = xt::zeros<int>(f.shape());
-    C2(f, g, mask, mask);
+    C2_batch(f, g, mask, mask, mode);
+}
+
+template <class T, class M>
+inline void Ensemble::C2_fft(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using value_type = typename T::value_type;
+
+    // lock statistic
+    m_stat = Type::C2;
+
+    // not periodic (default): mask padded items
+    xt::pad_mode pad_mode = xt::pad_mode::constant;
+    int mask_value = 1;
+
+    // periodic: unmask padded items
+    if (m_periodic) {
+        pad_mode = xt::pad_mode::periodic;
+        mask_value = 0;
+    }
+
+    // anchors: image and inverse of the mask
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<double, 3> Fmii = 1.0 - xt::atleast_3d(fmask);
+
+    // labels of the anchors (the direct loop skips "f == 0")
+    std::vector<value_type> labels;
+    for (size_t i = 0; i < F.size(); ++i) {
+        if (F.flat(i) != 0 && Fmii.flat(i) > 0) {
+            labels.push_back(F.flat(i));
+        }
+    }
+    std::sort(labels.begin(), labels.end());
+    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+
+    // one correlation per label: for many labels the direct loop is faster
+    if (!detail::fft::faster(labels.size() + 1, F.shape(), m_pad)) {
+        C2(f, g, fmask, gmask, compute_mode::direct);
+        return;
+    }
+
+    // comparison: padded image and inverse of the padded mask (padded as the direct loop)
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+    array_type::tensor<double, 3> Gmii =
+        1.0 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+
+    std::array<size_t, 3> shape = detail::fft::padded_shape(F.shape(), m_pad);
+    detail::fft::Plan3 plan = detail::fft::plan(shape);
+
+    // correlation (account for mask): sum of the correlations of the indicators of each label
+    for (auto& label : labels) {
+        array_type::tensor<double, 3> Fi = xt::where(xt::equal(F, label), Fmii, 0.0);
+        array_type::tensor<double, 3> Gi = xt::where(xt::equal(G, label), Gmii, 0.0);
+        this->accumulate(1, {true, false, false}, [&](size_t, size_t, auto first, auto, auto) {
+            detail::fft::add_correlation(Fi, Gi, m_pad, plan, first, true);
+        });
+    }
+
+    // normalisation
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::fft::add_correlation(Fmii, Gmii, m_pad, plan, norm, true);
+    });
+}
+
+template <class T, class M>
+inline void Ensemble::C2_unpadded(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    // lock statistic
+    m_stat = Type::C2;
+
+    // row-major items (read in-place if possible)
+    detail::RowMajor<T> F(f);
+    detail::RowMajor<T> G(g);
+    detail::RowMajor<M> Fmask(fmask);
+    detail::RowMajor<M> Gmask(gmask);
+
+    // image (3d, as "xt::atleast_3d"): padded items are read through index tables
+    std::array<size_t, 3> shape = detail::shape_3d(f.shape());
+    std::vector<std::vector<size_t>> pad = m_pad;
+    detail::unpadded::squeeze(shape, pad);
+    detail::unpadded::Tables tables = detail::unpadded::tables(shape, pad, m_periodic, m_nthreads);
+
+    // compute correlation
+    this->accumulate(
+        tables.chunks,
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::unpadded::C2(
+                shape,
+                pad,
+                tables,
+                begin,
+                end,
+                F.data(),
+                Fmask.data(),
+                G.data(),
+                Gmask.data(),
+                first,
+                norm);
+        });
 }
 
 } // namespace GooseEYE
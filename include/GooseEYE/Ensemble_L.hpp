@@ -20,6 +20,9 @@ inline void Ensemble::L(const T& f, path_mode mode)
 
     GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::L || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation, std::out_of_range);
+
+    Realization realization(this);
 
     // lock statistics
     m_stat = Type::L;
@@ -52,42 +55,59 @@ inline void Ensemble::L(const T& f, path_mode mode)
         xt::view(stamp, xt::all(), xt::keep(i)) -= m_pad[i][0];
     }
 
-    // correlation
-    // N.B. getting the pixel paths is relatively expensive, so it is the output-most loop
+    // pixel paths between the center of the ROI and each stamp point
+    // N.B. getting the pixel paths is relatively expensive, so they are computed once
+    std::vector<array_type::tensor<int, 2>> paths;
     for (size_t istamp = 0; istamp < stamp.shape(0); ++istamp) {
+        paths.push_back(GooseEYE::path(
+            {0, 0, 0}, {stamp(istamp, 0), stamp(istamp, 1), stamp(istamp, 2)}, mode));
+    }
+
+    // flat index of a lag in the region-of-interest
+    auto lag = [&](int dh, int di, int dj) -> size_t {
+        return ((m_pad[0][0] + dh) * m_shape[1] + m_pad[1][0] + di) * m_shape[2] + m_pad[2][0] + dj;
+    };
+
+    // rows of anchors (h, i) in the interior of the padded image
+    size_t n1 = F.shape(1) - m_pad[1][0] - m_pad[1][1];
+    size_t nrows = (F.shape(0) - m_pad[0][0] - m_pad[0][1]) * n1;
 
-        // pixel path between the center of the ROI and the current stamp point
-        array_type::tensor<int, 2> path =
-            GooseEYE::path({0, 0, 0}, {stamp(istamp, 0), stamp(istamp, 1), stamp(istamp, 2)}, mode);
-
-        // compute correlation along this path, for the entire image
-        for (size_t h = m_pad[0][0]; h < F.shape(0) - m_pad[0][1]; ++h) {
-            for (size_t i = m_pad[1][0]; i < F.shape(1) - m_pad[1][1]; ++i) {
-                for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
-                    for (size_t p = 0; p < path.shape(0); ++p) {
-                        // - get current relative position
-                        int dh = path(p, 0);
-                        int di = path(p, 1);
-                        int dj = path(p, 2);
-                        // - check to terminal walking along this path
-                        if (!F(h + dh, i + di, j + dj)) {
-                            break;
+    // correlation
+    this->accumulate(
+        nrows,
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto) {
+            for (auto& path : paths) {
+                // compute correlation along this path, for the (part of the) image
+                for (size_t row = begin; row < end; ++row) {
+                    size_t h = m_pad[0][0] + row / n1;
+                    size_t i = m_pad[1][0] + row % n1;
+                    for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
+                        for (size_t p = 0; p < path.shape(0); ++p) {
+                            // - get current relative position
+                            int dh = path(p, 0);
+                            int di = path(p, 1);
+                            int dj = path(p, 2);
+                            // - check to terminal walking along this path
+                            if (!F(h + dh, i + di, j + dj)) {
+                                break;
+                            }
+                            // - update the result
+                            first[lag(dh, di, dj)] += 1.0;
                         }
-                        // - update the result
-                        m_first(m_pad[0][0] + dh, m_pad[1][0] + di, m_pad[2][0] + dj) += 1.0;
                     }
                 }
             }
-        }
+        });
 
-        // normalisation
-        for (size_t p = 0; p < path.shape(0); ++p) {
-            int dh = path(p, 0);
-            int di = path(p, 1);
-            int dj = path(p, 2);
-            m_norm(m_pad[0][0] + dh, m_pad[1][0] + di, m_pad[2][0] + dj) += f.size();
+    // normalisation
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        for (auto& path : paths) {
+            for (size_t p = 0; p < path.shape(0); ++p) {
+                norm[lag(path(p, 0), path(p, 1), path(p, 2))] += static_cast<double>(f.size());
+            }
         }
-    }
+    });
 }
 
 } // namespace GooseEYE
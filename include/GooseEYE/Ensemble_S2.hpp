@@ -12,7 +12,8 @@
 namespace GooseEYE {
 
 template <class T, class M>
-inline void Ensemble::S2(const T& f, const T& g, const M& fmask, const M& gmask)
+inline void
+Ensemble::S2(const T& f, const T& g, const M& fmask, const M& gmask, compute_mode mode)
 {
     using value_type = typename T::value_type;
     using mask_type = typename M::value_type;
@@ -26,6 +27,31 @@ inline void Ensemble::S2(const T& f, const T& g, const M& fmask, const M& gmask)
     GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(fmask, gmask)), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode == compute_mode::fft) {
+        S2_fft(f, g, fmask, gmask);
+        return;
+    }
+
+    if (mode == compute_mode::binary) {
+        S2_binary(f, g, fmask, gmask);
+        return;
+    }
+
+    if (mode == compute_mode::sparse) {
+        S2_sparse(f, g, fmask, gmask);
+        return;
+    }
+
+    if (mode == compute_mode::unpadded) {
+        S2_unpadded(f, g, fmask, gmask);
+        return;
+    }
 
     // lock statistic
     m_stat = Type::S2;
@@ -40,51 +66,1046 @@ inline void Ensemble::S2(const T& f, const T& g, const M& fmask, const M& gmask)
         mask_value = 0;
     }
 
-    // apply padding
-    array_type::tensor<value_type, 3> F = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
-    array_type::tensor<double, 3> Fd = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
-    array_type::tensor<double, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
-    array_type::tensor<mask_type, 3> Fmask =
-        xt::pad(xt::atleast_3d(fmask), m_pad, xt::pad_mode::constant, mask_value);
-    array_type::tensor<double, 3> Gmask =
-        xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    // anchors
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<mask_type, 3> Fmask = xt::atleast_3d(fmask);
+
+    // comparison: apply padding (in the type of the image)
+    array_type::tensor<uint8_t, 3> Gmii =
+        1 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode) * Gmii;
+
+    // compute correlation
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::stencil::S2(
+                geo, begin, end, F.data(), Fmask.data(), G.data(), Gmii.data(), first, norm);
+        });
+}
+
+template <class T>
+inline void Ensemble::S2(const T& f, const T& g, compute_mode mode)
+{
+    using value_type = typename T::value_type;
+
+    Realization realization(this);
+
+    if (mode == compute_mode::fft && m_periodic) {
+        S2_fft(f, g);
+        return;
+    }
+
+    if (mode != compute_mode::direct) {
+        array_type::array<int> mask = xt::zeros<int>(f.shape());
+        S2(f, g, mask, mask, mode);
+        return;
+    }
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): the padded items are skipped
+    // periodic: the padded items are periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // anchors, and padded comparison (no masks)
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+
+    // compute correlation (first moment only)
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto) {
+            detail::stencil::S2(geo, m_periodic, begin, end, F.data(), G.data(), first);
+        });
+
+    // normalisation: analytical without masks
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::add_overlap(F.shape(), m_pad, m_periodic, norm);
+    });
+}
+
+template <class T>
+inline void Ensemble::S2(
+    const T& f,
+    const T& g,
+    const PackedMask& fmask,
+    const PackedMask& gmask,
+    compute_mode mode)
+{
+    using value_type = typename T::value_type;
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || fmask.data() == gmask.data(), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !fmask.any(), std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode != compute_mode::direct) {
+        S2(f, g, fmask.unpack(), gmask.unpack(), mode);
+        return;
+    }
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): pad with zeros
+    // periodic: pad with periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // inverse of the masks (packed along the last axis with extent, see "binary::roll"):
+    // anchors, and padded comparison
+    std::array<size_t, 3> shape = detail::shape_3d(f.shape());
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        padded[d] = shape[d] + m_pad[d][0] + m_pad[d][1];
+    }
+    size_t n = detail::binary::shift(shape, m_shape);
+    auto fmii = [&](size_t h, size_t i, size_t j) -> bool { return !fmask(h, i, j); };
+    auto gmasked = [&](size_t h, size_t i, size_t j) -> bool { return gmask(h, i, j); };
+    std::vector<detail::binary::word> Fmii =
+        detail::binary::pack(detail::binary::roll(shape, n), detail::binary::unroll(n, fmii));
+    std::vector<detail::binary::word> Gmii =
+        detail::binary::pack_inverse(shape, m_pad, m_periodic, n, gmasked);
+
+    // anchors, and padded comparison: masked items are set to zero
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+    detail::binary::apply(Fmii, detail::binary::roll(shape, n), F.data());
+    detail::binary::apply(Gmii, detail::binary::roll(padded, n), G.data());
+
+    // compute correlation (first moment only):
+    // masked items do not contribute, such that the loop does not need the masks
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto) {
+            detail::stencil::S2(geo, true, begin, end, F.data(), G.data(), first);
+        });
+
+    // normalisation: count co-occurrences of non-masked items
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::binary::correlate(
+            Fmii, Gmii, detail::binary::roll(shape, n), detail::binary::roll(m_shape, n), norm);
+    });
+}
+
+template <class T, class M>
+inline void
+Ensemble::S2_batch(const T& f, const T& g, const M& fmask, const M& gmask, compute_mode mode)
+{
+    using value_type = typename T::value_type;
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size() + 1, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(fmask, gmask)), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode == compute_mode::binary) {
+        for (size_t s = 0; s < f.shape(0); ++s) {
+            S2_binary(xt::view(f, s), xt::view(g, s), xt::view(fmask, s), xt::view(gmask, s));
+        }
+        return;
+    }
+
+    if (mode == compute_mode::sparse) {
+        for (size_t s = 0; s < f.shape(0); ++s) {
+            S2_sparse(xt::view(f, s), xt::view(g, s), xt::view(fmask, s), xt::view(gmask, s));
+        }
+        return;
+    }
+
+    if (mode == compute_mode::unpadded) {
+        for (size_t s = 0; s < f.shape(0); ++s) {
+            S2_unpadded(xt::view(f, s), xt::view(g, s), xt::view(fmask, s), xt::view(gmask, s));
+        }
+        return;
+    }
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): mask padded items
+    // periodic: unmask padded items
+    int mask_value = m_periodic ? 0 : 1;
+    bool fft = mode == compute_mode::fft;
+
+    // shape of one sample, and of one padded sample
+    std::array<size_t, 3> shape = detail::sample_shape(f.shape());
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        padded[d] = shape[d] + m_pad[d][0] + m_pad[d][1];
+    }
+
+    // geometry or transforms, shared by all samples
+    detail::stencil::Geometry geo = geometry(shape, m_autocorrelation);
+    detail::fft::Plan3 plan;
+    if (fft) {
+        plan = detail::fft::plan(detail::fft::padded_shape(shape, m_pad));
+    }
+
+    // distribute the samples over the threads
+    // N.B. the buffers are allocated once per thread (as "xt::xtensor", not to need Python)
+    this->accumulate(
+        f.shape(0),
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            xt::xtensor<value_type, 3> F = xt::empty<value_type>(shape);
+            xt::xtensor<mask_type, 3> Fmask = xt::empty<mask_type>(shape);
+            xt::xtensor<value_type, 3> G = xt::empty<value_type>(padded);
+            xt::xtensor<uint8_t, 3> Gmii = xt::empty<uint8_t>(padded);
+            xt::xtensor<double, 3> Fd;
+            xt::xtensor<double, 3> Fmii;
+
+            for (size_t s = begin; s < end; ++s) {
+
+                // anchors
+                xt::noalias(F) = xt::atleast_3d(xt::view(f, s));
+                xt::noalias(Fmask) = xt::atleast_3d(xt::view(fmask, s));
+
+                // comparison: apply padding (as the direct loop)
+                auto Gs = xt::atleast_3d(xt::view(g, s));
+                auto Gmask = xt::atleast_3d(xt::view(gmask, s));
+                detail::pad_into(Gmask, m_pad, false, mask_value, Gmii);
+                detail::pad_into(Gs, m_pad, m_periodic, 0, G);
+                xt::noalias(Gmii) = 1 - Gmii;
+                G *= Gmii;
+
+                if (!fft) {
+                    detail::stencil::S2(
+                        geo,
+                        0,
+                        geo.chunks(),
+                        F.data(),
+                        Fmask.data(),
+                        G.data(),
+                        Gmii.data(),
+                        first,
+                        norm);
+                    continue;
+                }
+
+                Fmii = 1.0 - Fmask;
+                Fd = F * Fmii;
+                detail::fft::add_correlation(
+                    Fd, G, m_pad, plan, first, std::is_integral<value_type>::value);
+                detail::fft::add_correlation(Fmii, Gmii, m_pad, plan, norm, true);
+            }
+        });
+}
+
+template <class T>
+inline void Ensemble::S2_batch(const T& f, const T& g, compute_mode mode)
+{
+    Realization realization(this);
+
+    if (mode != compute_mode::fft || !m_periodic) {
+        array_type::array<int> mask = xt::zeros<int>(f.shape());
+        S2_batch(f, g, mask, mask, mode);
+        return;
+    }
+
+    using value_type = typename T::value_type;
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size() + 1, std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // periodic cross-correlation of each sample, with transforms shared by all samples
+    std::array<size_t, 3> shape = detail::sample_shape(f.shape());
+    detail::fft::Plan3 plan = detail::fft::plan(shape);
+
+    this->accumulate(
+        f.shape(0),
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto) {
+            xt::xtensor<double, 3> F = xt::empty<double>(shape);
+            xt::xtensor<double, 3> G = xt::empty<double>(shape);
+
+            for (size_t s = begin; s < end; ++s) {
+                xt::noalias(F) = xt::atleast_3d(xt::view(f, s));
+                xt::noalias(G) = xt::atleast_3d(xt::view(g, s));
+                std::vector<double> c = detail::fft::correlate(F.data(), G.data(), plan);
+                detail::fft::add_lags(c, shape, m_pad, first, std::is_integral<value_type>::value);
+            }
+        });
+
+    // normalisation: each pixel is an anchor for each lag
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        for (size_t i = 0; i < m_shape[0] * m_shape[1] * m_shape[2]; ++i) {
+            norm[i] += static_cast<double>(f.size());
+        }
+    });
+}
+
+template <size_t Rx, size_t Ry, class T>
+inline void Ensemble::S2(const T& f, const T& g)
+{
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == 2, std::out_of_range);
+    GOOSEEYE_ASSERT(m_shape_orig.size() == 2, std::out_of_range);
+    GOOSEEYE_ASSERT(m_shape_orig[0] == Rx && m_shape_orig[1] == Ry, std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // row-major items (read in-place if possible)
+    detail::RowMajor<T> F(f);
+    detail::RowMajor<T> G(g);
+
+    // compute correlation (all lags)
+    std::array<double, Rx * Ry> sums = {};
+    detail::fixed::S2<Rx, Ry>(f.shape(0), f.shape(1), F.data(), G.data(), m_periodic, sums);
+
+    // normalisation: each anchor for each lag that is part of the image
+    std::array<size_t, 3> shape = {f.shape(0), f.shape(1), 1};
+
+    this->accumulate(1, {true, false, true}, [&](size_t, size_t, auto first, auto, auto norm) {
+        for (size_t i = 0; i < Rx * Ry; ++i) {
+            first[i] += sums[i];
+        }
+        detail::add_overlap(shape, m_pad, m_periodic, norm);
+    });
+}
+
+template <class T, class M>
+inline void Ensemble::S2_slab(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() >= 2, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(fmask, gmask)), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // convert to quasi-3d (without copy)
+    auto F = xt::atleast_3d(f);
+    auto G = xt::atleast_3d(g);
+    auto Fmask = xt::atleast_3d(fmask);
+    auto Gmask = xt::atleast_3d(gmask);
+
+    // first slab: fix the shape of the rows
+    if (m_slabs.rows == 0) {
+        m_slabs.shape = {0, F.shape(1), F.shape(2)};
+    }
+
+    GOOSEEYE_ASSERT(F.shape(1) == m_slabs.shape[1], std::out_of_range);
+    GOOSEEYE_ASSERT(F.shape(2) == m_slabs.shape[2], std::out_of_range);
+
+    // append the rows to the window
+    for (size_t h = 0; h < F.shape(0); ++h) {
+        for (size_t i = 0; i < F.shape(1); ++i) {
+            for (size_t j = 0; j < F.shape(2); ++j) {
+                m_slabs.f.push_back(static_cast<double>(F(h, i, j)));
+                m_slabs.g.push_back(static_cast<double>(G(h, i, j)));
+                m_slabs.fmask.push_back(static_cast<uint8_t>(Fmask(h, i, j)));
+                m_slabs.gmask.push_back(static_cast<uint8_t>(Gmask(h, i, j)));
+            }
+        }
+    }
+
+    m_slabs.rows += F.shape(0);
+
+    this->S2_slab_process(false);
+}
+
+template <class T>
+inline void Ensemble::S2_slab(const T& f, const T& g)
+{
+    array_type::array<int> mask = xt::zeros<int>(f.shape());
+    S2_slab(f, g, mask, mask);
+}
+
+inline void Ensemble::S2_slab_end()
+{
+    GOOSEEYE_ASSERT(m_slabs.rows > 0, std::out_of_range);
+
+    Realization realization(this);
+
+    this->S2_slab_process(true);
+    m_slabs = Slabs();
+}
+
+inline void Ensemble::S2_slab_process(bool end)
+{
+    Slabs& s = m_slabs;
+    size_t n = s.shape[1] * s.shape[2];
+    size_t before = m_pad[0][0];
+    size_t after = m_pad[0][1];
+
+    // periodic: keep the first rows (copy before they are released from the window),
+    // the rows of anchors "[0, before)" and the rows that are compared to the last anchors
+    if (m_periodic) {
+        size_t head = std::min(s.rows, before + after);
+        for (; s.head < head; ++s.head) {
+            size_t k = (s.head - s.offset) * n;
+            s.head_f.insert(s.head_f.end(), s.f.begin() + k, s.f.begin() + k + n);
+            s.head_g.insert(s.head_g.end(), s.g.begin() + k, s.g.begin() + k + n);
+            s.head_fmask.insert(s.head_fmask.end(), s.fmask.begin() + k, s.fmask.begin() + k + n);
+            s.head_gmask.insert(s.head_gmask.end(), s.gmask.begin() + k, s.gmask.begin() + k + n);
+        }
+    }
+
+    // anchors for which all rows are available
+    // (periodic: the first rows of anchors need the last rows, they are processed at the end)
+    size_t begin = std::max(s.done, m_periodic ? before : 0);
+    size_t stop = s.rows;
+
+    if (!end) {
+        stop = s.rows > after ? s.rows - after : 0;
+    }
+
+    if (stop > begin) {
+        this->S2_slab_anchors(begin, stop);
+        s.done = stop;
+    }
+
+    if (end && m_periodic) {
+        this->S2_slab_anchors(0, std::min(before, s.rows));
+    }
+
+    // release the rows that are no longer needed
+    size_t keep = s.done > before ? s.done - before : 0;
+
+    if (keep > s.offset) {
+        size_t k = (keep - s.offset) * n;
+        s.f.erase(s.f.begin(), s.f.begin() + k);
+        s.g.erase(s.g.begin(), s.g.begin() + k);
+        s.fmask.erase(s.fmask.begin(), s.fmask.begin() + k);
+        s.gmask.erase(s.gmask.begin(), s.gmask.begin() + k);
+        s.offset = keep;
+    }
+}
+
+inline void Ensemble::S2_slab_anchors(size_t begin, size_t end)
+{
+    const Slabs& s = m_slabs;
+    size_t n = s.shape[1] * s.shape[2];
+
+    // offset of a row in the window (or in the head, if it is no longer in the window)
+    auto row = [&](size_t r, const auto& window, const auto& head) {
+        if (r >= s.offset && r < s.rows) {
+            return window.data() + (r - s.offset) * n;
+        }
+        GOOSEEYE_ASSERT(r < s.head, std::out_of_range);
+        return head.data() + r * n;
+    };
+
+    std::array<size_t, 3> shape = {end - begin, s.shape[1], s.shape[2]};
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        padded[d] = shape[d] + m_pad[d][0] + m_pad[d][1];
+    }
+
+    // anchors
+    std::vector<double> F(shape[0] * n);
+    std::vector<uint8_t> Fmask(shape[0] * n);
+
+    for (size_t h = 0; h < shape[0]; ++h) {
+        const double* f = row(begin + h, s.f, s.head_f);
+        const uint8_t* fmask = row(begin + h, s.fmask, s.head_fmask);
+        std::copy(f, f + n, F.begin() + h * n);
+        std::copy(fmask, fmask + n, Fmask.begin() + h * n);
+    }
+
+    // comparison: rows "[begin - pad[0][0], end + pad[0][1])" with padding as the direct loop,
+    // i.e. padded items are periodic copies that are not masked (periodic),
+    // or zero and masked (not periodic)
+    // per axis: index of each padded item ("-1" for a padded item that is zero and masked),
+    // and if it is a padded item (along the first axis: outside the image)
+    std::array<std::vector<ptrdiff_t>, 3> index;
+    std::array<std::vector<bool>, 3> outside;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ptrdiff_t m = static_cast<ptrdiff_t>(d == 0 ? s.rows : shape[d]);
+        ptrdiff_t o = static_cast<ptrdiff_t>(d == 0 ? begin : 0);
+        index[d].resize(padded[d]);
+        outside[d].resize(padded[d]);
+        for (size_t p = 0; p < padded[d]; ++p) {
+            ptrdiff_t q = o + static_cast<ptrdiff_t>(p) - static_cast<ptrdiff_t>(m_pad[d][0]);
+            outside[d][p] = q < 0 || q >= m;
+            if (!outside[d][p]) {
+                index[d][p] = q;
+            }
+            else if (m_periodic) {
+                index[d][p] = ((q % m) + m) % m;
+            }
+            else {
+                index[d][p] = -1;
+            }
+        }
+    }
+
+    std::vector<double> G(padded[0] * padded[1] * padded[2]);
+    std::vector<double> Gmii(G.size());
+
+    for (size_t h = 0; h < padded[0]; ++h) {
+        const double* g = nullptr;
+        const uint8_t* gmask = nullptr;
+        if (index[0][h] >= 0) {
+            g = row(static_cast<size_t>(index[0][h]), s.g, s.head_g);
+            gmask = row(static_cast<size_t>(index[0][h]), s.gmask, s.head_gmask);
+        }
+        for (size_t i = 0; i < padded[1]; ++i) {
+            for (size_t j = 0; j < padded[2]; ++j) {
+                size_t k = (h * padded[1] + i) * padded[2] + j;
+                if (index[0][h] < 0 || index[1][i] < 0 || index[2][j] < 0) {
+                    G[k] = 0.0;
+                    Gmii[k] = 0.0;
+                    continue;
+                }
+                size_t l = static_cast<size_t>(index[1][i]) * shape[2];
+                l += static_cast<size_t>(index[2][j]);
+                double mii = 1.0;
+                if (!outside[0][h] && !outside[1][i] && !outside[2][j]) {
+                    mii -= static_cast<double>(gmask[l]);
+                }
+                G[k] = g[l] * mii;
+                Gmii[k] = mii;
+            }
+        }
+    }
 
     // compute correlation
-    for (size_t h = m_pad[0][0]; h < F.shape(0) - m_pad[0][1]; ++h) {
-        for (size_t i = m_pad[1][0]; i < F.shape(1) - m_pad[1][1]; ++i) {
-            for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
-                // - skip masked
-                if (Fmask(h, i, j)) {
+    detail::stencil::Geometry geo = geometry(shape, m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, true},
+        [&](size_t b, size_t e, auto first, auto, auto norm) {
+            detail::stencil::S2(
+                geo, b, e, F.data(), Fmask.data(), G.data(), Gmii.data(), first, norm);
+        });
+}
+
+template <class T, class M>
+inline void Ensemble::S2_incremental(const T& f, const M& mask)
+{
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, mask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(mask, 0) || xt::equal(mask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(mask), std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): mask padded items
+    // periodic: unmask padded items
+    int mask_value = m_periodic ? 0 : 1;
+
+    Incremental& s = m_incremental;
+    s.F = xt::atleast_3d(f);
+    s.Fmask = xt::atleast_3d(mask);
+
+    std::array<size_t, 3> shape;
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        shape[d] = s.F.shape(d);
+        padded[d] = shape[d] + m_pad[d][0] + m_pad[d][1];
+    }
+
+    // comparison: apply padding (as the direct loop)
+    s.G = xt::empty<double>(padded);
+    s.Gmii = xt::empty<double>(padded);
+    detail::pad_into(s.Fmask, m_pad, false, mask_value, s.Gmii);
+    detail::pad_into(s.F, m_pad, m_periodic, 0, s.G);
+    s.Gmii = 1.0 - s.Gmii;
+    s.G *= s.Gmii;
+
+    // per axis: the items of the padded image that are (periodic) copies of an item of the image
+    for (size_t d = 0; d < 3; ++d) {
+        s.copies[d].assign(shape[d], {});
+        for (size_t p = 0; p < padded[d]; ++p) {
+            size_t q = (p + shape[d] - m_pad[d][0] % shape[d]) % shape[d];
+            if (m_periodic || (p >= m_pad[d][0] && p < m_pad[d][0] + shape[d])) {
+                s.copies[d][q].push_back(p);
+            }
+        }
+    }
+
+    // correlation of the image (all lags, such that it can be updated)
+    s.first = xt::zeros<double>(m_shape);
+    s.norm = xt::zeros<double>(m_shape);
+    detail::stencil::Geometry geo = geometry(shape, false);
+    detail::thread::accumulate(
+        m_nthreads,
+        geo.chunks(),
+        s.first.size(),
+        {s.first.data(), s.norm.data()},
+        [&](size_t begin, size_t end, const std::vector<double*>& ret) {
+            detail::stencil::S2(
+                geo,
+                begin,
+                end,
+                s.F.data(),
+                s.Fmask.data(),
+                s.G.data(),
+                s.Gmii.data(),
+                ret[0],
+                ret[1]);
+        });
+
+    this->accumulate(1, {true, false, true}, [&](size_t, size_t, auto first, auto, auto norm) {
+        for (size_t i = 0; i < s.first.size(); ++i) {
+            first[i] += s.first.flat(i);
+            norm[i] += s.norm.flat(i);
+        }
+    });
+}
+
+template <class T>
+inline void Ensemble::S2_incremental(const T& f)
+{
+    array_type::array<int> mask = xt::zeros<int>(f.shape());
+    S2_incremental(f, mask);
+}
+
+template <class I, class T>
+inline void Ensemble::S2_update(const I& index, const T& old, const T& value)
+{
+    Incremental& s = m_incremental;
+
+    GOOSEEYE_ASSERT(s.F.size() > 0, std::out_of_range);
+    GOOSEEYE_ASSERT(index.size() == old.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(index.size() == value.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2, std::out_of_range);
+
+    for (size_t c = 0; c < index.size(); ++c) {
+        GOOSEEYE_ASSERT(static_cast<size_t>(index.flat(c)) < s.F.size(), std::out_of_range);
+        GOOSEEYE_ASSERT(s.F.flat(index.flat(c)) == old.flat(c), std::out_of_range);
+    }
+
+    Realization realization(this);
+
+    for (size_t c = 0; c < index.size(); ++c) {
+        this->S2_change(static_cast<size_t>(index.flat(c)), static_cast<double>(value.flat(c)));
+    }
+
+    this->accumulate(1, {true, false, true}, [&](size_t, size_t, auto first, auto, auto norm) {
+        for (size_t i = 0; i < s.first.size(); ++i) {
+            first[i] += s.first.flat(i);
+            norm[i] += s.norm.flat(i);
+        }
+    });
+}
+
+inline void Ensemble::S2_change(size_t index, double value)
+{
+    Incremental& s = m_incremental;
+    size_t h = index / (s.F.shape(1) * s.F.shape(2));
+    size_t i = (index / s.F.shape(2)) % s.F.shape(1);
+    size_t j = index % s.F.shape(2);
+    double df = value - s.F.flat(index);
+
+    if (df == 0) {
+        return;
+    }
+
+    // change as anchor (with the old comparison image)
+    if (!s.Fmask.flat(index)) {
+        for (size_t a = 0; a < m_shape[0]; ++a) {
+            for (size_t b = 0; b < m_shape[1]; ++b) {
+                for (size_t c = 0; c < m_shape[2]; ++c) {
+                    s.first(a, b, c) += df * s.G(h + a, i + b, j + c);
+                }
+            }
+        }
+    }
+
+    s.F.flat(index) = value;
+
+    // change as comparison (with the new image as anchors), for each copy in the padded image:
+    // the padded item "(ph, pi, pj)" is compared to the anchor "(ph - a, pi - b, pj - c)"
+    for (size_t ph : s.copies[0][h]) {
+        for (size_t pi : s.copies[1][i]) {
+            for (size_t pj : s.copies[2][j]) {
+                double gmii = s.Gmii(ph, pi, pj);
+                if (gmii == 0) {
                     continue;
                 }
-                // - get comparison sub-matrix
-                auto Gi = xt::view(
-                    G,
-                    xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                    xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                    xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - get inverse of comparison mask
-                auto Gmii = 1.0 - xt::view(
-                                      Gmask,
-                                      xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                                      xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                                      xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - correlation (account for mask)
-                if (F(h, i, j) != 0) {
-                    m_first += Fd(h, i, j) * Gi * Gmii;
+                double dg = df * gmii;
+                for (size_t a = 0; a < m_shape[0]; ++a) {
+                    if (a > ph || ph - a >= s.F.shape(0)) {
+                        continue;
+                    }
+                    for (size_t b = 0; b < m_shape[1]; ++b) {
+                        if (b > pi || pi - b >= s.F.shape(1)) {
+                            continue;
+                        }
+                        for (size_t c = 0; c < m_shape[2]; ++c) {
+                            if (c > pj || pj - c >= s.F.shape(2)) {
+                                continue;
+                            }
+                            if (!s.Fmask(ph - a, pi - b, pj - c)) {
+                                s.first(a, b, c) += s.F(ph - a, pi - b, pj - c) * dg;
+                            }
+                        }
+                    }
                 }
-                // - normalisation
-                m_norm += Gmii;
+                s.G(ph, pi, pj) = value * gmii;
             }
         }
     }
 }
 
+template <class T, class M>
+inline void Ensemble::S2_sampled(
+    const T& f,
+    const T& g,
+    const M& fmask,
+    const M& gmask,
+    size_t samples,
+    uint64_t seed)
+{
+    using mask_type = typename M::value_type;
+
+    static_assert(std::is_integral<mask_type>::value, "Integral mask required.");
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, fmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::has_shape(f, gmask.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(f.size() > 0, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2_sampled || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(fmask, gmask)), std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::S2_sampled;
+
+    // shape of the image (3d, as "xt::atleast_3d")
+    std::array<size_t, 3> shape = detail::shape_3d(f.shape());
+
+    // row-major items (read in-place if possible)
+    detail::RowMajor<T> F(f);
+    detail::RowMajor<T> G(g);
+    detail::RowMajor<M> Fmask(fmask);
+    detail::RowMajor<M> Gmask(gmask);
+
+    // anchors
+    prrng::pcg32 rng(seed);
+    std::vector<size_t> anchors = detail::sampled::anchors(f.size(), samples, rng);
+
+    // compute correlation (all lags)
+    this->accumulate(
+        anchors.size(),
+        {true, true, true},
+        [&](size_t begin, size_t end, auto first, auto second, auto norm) {
+            detail::sampled::S2(
+                shape,
+                m_pad,
+                m_periodic,
+                anchors,
+                begin,
+                end,
+                F.data(),
+                Fmask.data(),
+                G.data(),
+                Gmask.data(),
+                first,
+                second,
+                norm);
+        });
+}
+
 template <class T>
-inline void Ensemble::S2(const T& f, const T& g)
+inline void Ensemble::S2_sampled(const T& f, const T& g, size_t samples, uint64_t seed)
 {
     array_type::array<int> mask = xt::zeros<int>(f.shape());
-    S2(f, g, mask, mask);
+    S2_sampled(f, g, mask, mask, samples, seed);
+}
+
+template <class T>
+inline void Ensemble::S2_fft(const T& f, const T& g)
+{
+    using value_type = typename T::value_type;
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::S2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_periodic, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation || xt::all(xt::equal(f, g)), std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // convert to quasi-3d
+    array_type::tensor<double, 3> F = xt::atleast_3d(f);
+    array_type::tensor<double, 3> G = xt::atleast_3d(g);
+
+    // periodic cross-correlation of the full image, crop to the region-of-interest
+    // (the sum of products of integers is an integer: rounding gives the exact result)
+    detail::fft::Plan3 plan = detail::fft::plan(F.shape());
+    std::vector<double> c = detail::fft::correlate(F.data(), G.data(), plan);
+    bool round = std::is_integral<value_type>::value;
+
+    // normalisation: each pixel is an anchor for each lag
+    this->accumulate(1, {true, false, true}, [&](size_t, size_t, auto first, auto, auto norm) {
+        detail::fft::add_lags(c, F.shape(), m_pad, first, round);
+        for (size_t i = 0; i < m_shape[0] * m_shape[1] * m_shape[2]; ++i) {
+            norm[i] += static_cast<double>(F.size());
+        }
+    });
+}
+
+template <class T, class M>
+inline void Ensemble::S2_fft(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using value_type = typename T::value_type;
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): mask padded items
+    xt::pad_mode pad_mode = xt::pad_mode::constant;
+    int mask_value = 1;
+
+    // periodic: unmask padded items
+    if (m_periodic) {
+        pad_mode = xt::pad_mode::periodic;
+        mask_value = 0;
+    }
+
+    // anchors: image and inverse of the mask
+    array_type::tensor<double, 3> Fmii = 1.0 - xt::atleast_3d(fmask);
+    array_type::tensor<double, 3> F = xt::atleast_3d(f) * Fmii;
+
+    // comparison: padded image and inverse of the padded mask (padded as the direct loop)
+    array_type::tensor<double, 3> Gmii =
+        1.0 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    array_type::tensor<double, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode) * Gmii;
+
+    // correlation (account for mask) and normalisation,
+    // in a zero-padded array in which no lag wraps around
+    std::array<size_t, 3> shape = detail::fft::padded_shape(F.shape(), m_pad);
+    detail::fft::Plan3 plan = detail::fft::plan(shape);
+    bool round = std::is_integral<value_type>::value;
+
+    this->accumulate(1, {true, false, true}, [&](size_t, size_t, auto first, auto, auto norm) {
+        detail::fft::add_correlation(F, G, m_pad, plan, first, round);
+        detail::fft::add_correlation(Fmii, Gmii, m_pad, plan, norm, true);
+    });
+}
+
+template <class T, class M>
+inline void Ensemble::S2_binary(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    GOOSEEYE_ASSERT(xt::all(xt::equal(f, 0) || xt::equal(f, 1)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(g, 0) || xt::equal(g, 1)), std::out_of_range);
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // convert to quasi-3d (without copy)
+    auto F = xt::atleast_3d(f);
+    auto G = xt::atleast_3d(g);
+    auto Fmask = xt::atleast_3d(fmask);
+    auto Gmask = xt::atleast_3d(gmask);
+
+    std::array<size_t, 3> shape;
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        shape[d] = F.shape(d);
+        padded[d] = shape[d] + m_shape[d] - 1;
+    }
+
+    // check if an item of the padded image (padded as the direct loop) is a padded item
+    auto outside = [&](size_t d, size_t p) -> bool {
+        return p < m_pad[d][0] || p >= m_pad[d][0] + shape[d];
+    };
+
+    // index in the image of an item of the padded image (periodic)
+    auto index = [&](size_t d, size_t p) -> size_t {
+        return (p + shape[d] - m_pad[d][0] % shape[d]) % shape[d];
+    };
+
+    // inverse of the padded comparison mask:
+    // padded items are not masked if periodic, and masked if not periodic
+    auto gmii = [&](size_t h, size_t i, size_t j) -> bool {
+        if (outside(0, h) || outside(1, i) || outside(2, j)) {
+            return m_periodic;
+        }
+        return !Gmask(h - m_pad[0][0], i - m_pad[1][0], j - m_pad[2][0]);
+    };
+
+    // anchors, and padded comparison image (account for mask)
+    auto a = [&](size_t h, size_t i, size_t j) -> bool { return !Fmask(h, i, j) && F(h, i, j); };
+    auto am = [&](size_t h, size_t i, size_t j) -> bool { return !Fmask(h, i, j); };
+    auto b = [&](size_t h, size_t i, size_t j) -> bool {
+        return gmii(h, i, j) && G(index(0, h), index(1, i), index(2, j));
+    };
+
+    // pack along the last axis with extent (e.g. along the signal of a 1d image)
+    size_t n = detail::binary::shift(shape, m_shape);
+    std::array<size_t, 3> rolled = detail::binary::roll(shape, n);
+    std::array<size_t, 3> roi = detail::binary::roll(m_shape, n);
+    std::vector<detail::binary::word> A =
+        detail::binary::pack(rolled, detail::binary::unroll(n, a));
+    std::vector<detail::binary::word> Am =
+        detail::binary::pack(rolled, detail::binary::unroll(n, am));
+    std::vector<detail::binary::word> B =
+        detail::binary::pack(detail::binary::roll(padded, n), detail::binary::unroll(n, b));
+    std::vector<detail::binary::word> Bm =
+        detail::binary::pack(detail::binary::roll(padded, n), detail::binary::unroll(n, gmii));
+
+    // count co-occurrences
+    this->accumulate(1, {true, false, true}, [&](size_t, size_t, auto first, auto, auto norm) {
+        detail::binary::correlate(A, B, rolled, roi, first);
+        detail::binary::correlate(Am, Bm, rolled, roi, norm);
+    });
+}
+
+template <class T, class M>
+inline void Ensemble::S2_sparse(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    using value_type = typename T::value_type;
+
+    // lock statistic
+    m_stat = Type::S2;
+
+    // not periodic (default): mask padded items
+    xt::pad_mode pad_mode = xt::pad_mode::constant;
+    int mask_value = 1;
+
+    // periodic: unmask padded items
+    if (m_periodic) {
+        pad_mode = xt::pad_mode::periodic;
+        mask_value = 0;
+    }
+
+    // anchors: masked anchors do not contribute to the first moment
+    auto Fmask = xt::atleast_3d(fmask);
+    array_type::tensor<value_type, 3> F =
+        xt::where(xt::equal(Fmask, 0), xt::atleast_3d(f), static_cast<value_type>(0));
+    std::vector<size_t> anchors = detail::stencil::nonzero(F.size(), F.data());
+
+    // comparison: apply padding (in the type of the image)
+    array_type::tensor<uint8_t, 3> Gmii =
+        1 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode) * Gmii;
+
+    // compute correlation (first moment only)
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        anchors.size(),
+        {true, false, false},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::stencil::sparse(
+                geo, anchors, begin, end, F.data(), G.data(), Gmii.data(), first, norm);
+        });
+
+    // normalisation: analytical without masks
+    if (!xt::any(fmask) && !xt::any(gmask)) {
+        this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+            detail::add_overlap(F.shape(), m_pad, m_periodic, norm);
+        });
+        return;
+    }
+
+    // normalisation: correlation of the masks (in a zero-padded array, no lag wraps around)
+    array_type::tensor<double, 3> Fmii = 1.0 - Fmask;
+    detail::fft::Plan3 plan = detail::fft::plan(detail::fft::padded_shape(F.shape(), m_pad));
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::fft::add_correlation(Fmii, Gmii, m_pad, plan, norm, true);
+    });
+}
+
+template <class T, class M>
+inline void Ensemble::S2_unpadded(const T& f, const T& g, const M& fmask, const M& gmask)
+{
+    // lock statistic
+    m_stat = Type::S2;
+
+    // row-major items (read in-place if possible)
+    detail::RowMajor<T> F(f);
+    detail::RowMajor<T> G(g);
+    detail::RowMajor<M> Fmask(fmask);
+    detail::RowMajor<M> Gmask(gmask);
+
+    // image (3d, as "xt::atleast_3d"): padded items are read through index tables
+    std::array<size_t, 3> shape = detail::shape_3d(f.shape());
+    std::vector<std::vector<size_t>> pad = m_pad;
+    detail::unpadded::squeeze(shape, pad);
+    detail::unpadded::Tables tables = detail::unpadded::tables(shape, pad, m_periodic, m_nthreads);
+
+    // compute correlation
+    this->accumulate(
+        tables.chunks,
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::unpadded::S2(
+                shape,
+                pad,
+                tables,
+                begin,
+                end,
+                F.data(),
+                Fmask.data(),
+                G.data(),
+                Gmask.data(),
+                first,
+                norm);
+        });
 }
 
 } // namespace GooseEYE
@@ -12,7 +12,7 @@
 namespace GooseEYE {
 
 template <class T, class M>
-inline void Ensemble::W2(const T& f, const T& g, const M& gmask)
+inline void Ensemble::W2(const T& f, const T& g, const M& gmask, compute_mode mode)
 {
     using value_type = typename T::value_type;
     using mask_type = typename M::value_type;
@@ -24,6 +24,17 @@ inline void Ensemble::W2(const T& f, const T& g, const M& gmask)
     GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
     GOOSEEYE_ASSERT(xt::all(xt::equal(gmask, 0) || xt::equal(gmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::W2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation, std::out_of_range);
+    GOOSEEYE_REQUIRE(mode != compute_mode::fft, std::out_of_range);
+    GOOSEEYE_REQUIRE(mode != compute_mode::binary, std::out_of_range);
+
+    Realization realization(this);
+
+    if (mode == compute_mode::unpadded) {
+        W2_unpadded(f, g, gmask);
+        return;
+    }
 
     // lock statistic
     m_stat = Type::W2;
@@ -38,45 +49,102 @@ inline void Ensemble::W2(const T& f, const T& g, const M& gmask)
         mask_value = 0;
     }
 
-    // apply padding
-    array_type::tensor<value_type, 3> F = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
-    array_type::tensor<double, 3> Fd = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
-    array_type::tensor<double, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
-    array_type::tensor<double, 3> Gmask =
-        xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    // weights
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+
+    // comparison: apply padding (in the type of the image)
+    array_type::tensor<uint8_t, 3> Gmii =
+        1 - xt::pad(xt::atleast_3d(gmask), m_pad, xt::pad_mode::constant, mask_value);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode) * Gmii;
 
     // compute correlation
-    for (size_t h = m_pad[0][0]; h < F.shape(0) - m_pad[0][1]; ++h) {
-        for (size_t i = m_pad[1][0]; i < F.shape(1) - m_pad[1][1]; ++i) {
-            for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
-                // - get comparison sub-matrix
-                auto Gi = xt::view(
-                    G,
-                    xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                    xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                    xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - get inverse of comparison mask
-                auto Gmii = 1.0 - xt::view(
-                                      Gmask,
-                                      xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                                      xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                                      xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - correlation (account for mask)
-                if (F(h, i, j) != 0) {
-                    m_first += Fd(h, i, j) * Gi * Gmii;
-                }
-                // - normalisation
-                m_norm += F(h, i, j) * Gmii;
-            }
-        }
+    detail::stencil::Geometry geo = geometry(F.shape(), false);
+
+    if (mode == compute_mode::sparse) {
+        std::vector<size_t> anchors = detail::stencil::nonzero(F.size(), F.data());
+        this->accumulate(
+            anchors.size(),
+            {true, false, true},
+            [&](size_t begin, size_t end, auto first, auto, auto norm) {
+                detail::stencil::sparse(
+                    geo, anchors, begin, end, F.data(), G.data(), Gmii.data(), first, norm);
+            });
+        return;
     }
+
+    this->accumulate(
+        geo.chunks(),
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::stencil::W2(geo, begin, end, F.data(), G.data(), Gmii.data(), first, norm);
+        });
 }
 
 template <class T>
-inline void Ensemble::W2(const T& f, const T& g)
+inline void Ensemble::W2(const T& f, const T& g, compute_mode mode)
 {
-    array_type::array<int> mask = xt::zeros<int>(f.shape());
-    W2(f, g, mask);
+    using value_type = typename T::value_type;
+
+    if (mode != compute_mode::direct) {
+        array_type::array<int> mask = xt::zeros<int>(f.shape());
+        W2(f, g, mask, mode);
+        return;
+    }
+
+    GOOSEEYE_ASSERT(xt::has_shape(f, g.shape()), std::out_of_range);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::W2 || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation, std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::W2;
+
+    // not periodic (default): the padded items are skipped
+    // periodic: the padded items are periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // weights, and padded comparison (no mask)
+    array_type::tensor<value_type, 3> F = xt::atleast_3d(f);
+    array_type::tensor<value_type, 3> G = xt::pad(xt::atleast_3d(g), m_pad, pad_mode);
+
+    // compute correlation
+    detail::stencil::Geometry geo = geometry(F.shape(), false);
+    this->accumulate(
+        geo.chunks(),
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::stencil::W2(geo, m_periodic, begin, end, F.data(), G.data(), first, norm);
+        });
+}
+
+template <class T, class M>
+inline void Ensemble::W2_unpadded(const T& f, const T& g, const M& gmask)
+{
+    // lock statistic
+    m_stat = Type::W2;
+
+    // row-major items (read in-place if possible)
+    detail::RowMajor<T> F(f);
+    detail::RowMajor<T> G(g);
+    detail::RowMajor<M> Gmask(gmask);
+
+    // image (3d, as "xt::atleast_3d"): padded items are read through index tables
+    std::array<size_t, 3> shape = detail::shape_3d(f.shape());
+    std::vector<std::vector<size_t>> pad = m_pad;
+    detail::unpadded::squeeze(shape, pad);
+    detail::unpadded::Tables tables = detail::unpadded::tables(shape, pad, m_periodic, m_nthreads);
+
+    // compute correlation
+    this->accumulate(
+        tables.chunks,
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            detail::unpadded::W2(
+                shape, pad, tables, begin, end, F.data(), G.data(), Gmask.data(), first, norm);
+        });
 }
 
 } // namespace GooseEYE
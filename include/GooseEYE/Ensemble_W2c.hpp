@@ -28,6 +28,10 @@ Ensemble::W2c(const C& clusters, const C& centers, const T& f, const M& fmask, p
     GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
     GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::W2c || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation, std::out_of_range);
+
+    Realization realization(this);
 
     // lock statistic
     m_stat = Type::W2c;
@@ -65,58 +69,68 @@ Ensemble::W2c(const C& clusters, const C& centers, const T& f, const M& fmask, p
         xt::view(stamp, xt::all(), xt::keep(i)) -= m_pad[i][0];
     }
 
-    // correlation
-    // N.B. getting the pixel paths is relatively expensive, so it is the output-most loop
+    // pixel paths between the center of the ROI and each stamp point
+    // N.B. getting the pixel paths is relatively expensive, so they are computed once
+    std::vector<array_type::tensor<int, 2>> paths;
     for (size_t istamp = 0; istamp < stamp.shape(0); ++istamp) {
+        paths.push_back(GooseEYE::path(
+            {0, 0, 0}, {stamp(istamp, 0), stamp(istamp, 1), stamp(istamp, 2)}, mode));
+    }
 
-        // pixel path between the center of the ROI and the current stamp point
-        array_type::tensor<int, 2> path =
-            GooseEYE::path({0, 0, 0}, {stamp(istamp, 0), stamp(istamp, 1), stamp(istamp, 2)}, mode);
-
-        for (size_t h = m_pad[0][0]; h < F.shape(0) - m_pad[0][1]; ++h) {
-            for (size_t i = m_pad[1][0]; i < F.shape(1) - m_pad[1][1]; ++i) {
-                for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
+    // flat index of the lag at which a path is stored
+    auto lag = [&](int dh, int di, int dj) -> size_t {
+        return ((m_pad[0][0] + dh) * m_shape[1] + m_pad[1][0] + di) * m_shape[2] + m_pad[1][0] + dj;
+    };
 
-                    auto label = Centers(h, i, j);
-                    int q = -1;
+    // rows of anchors (h, i) in the interior of the padded image
+    size_t n1 = F.shape(1) - m_pad[1][0] - m_pad[1][1];
+    size_t nrows = (F.shape(0) - m_pad[0][0] - m_pad[0][1]) * n1;
 
-                    // proceed only when the centre is inside the cluster
-                    if (!label || Clusters(h, i, j) != label) {
-                        continue;
-                    }
+    // correlation
+    this->accumulate(
+        nrows,
+        {true, false, true},
+        [&](size_t begin, size_t end, auto first, auto, auto norm) {
+            for (auto& path : paths) {
+                for (size_t row = begin; row < end; ++row) {
+                    size_t h = m_pad[0][0] + row / n1;
+                    size_t i = m_pad[1][0] + row % n1;
+                    for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
+
+                        auto label = Centers(h, i, j);
+                        int q = -1;
+
+                        // proceed only when the centre is inside the cluster
+                        if (!label || Clusters(h, i, j) != label) {
+                            continue;
+                        }
 
-                    for (size_t p = 0; p < path.shape(0); ++p) {
+                        for (size_t p = 0; p < path.shape(0); ++p) {
 
-                        int dh = path(p, 0);
-                        int di = path(p, 1);
-                        int dj = path(p, 2);
+                            int dh = path(p, 0);
+                            int di = path(p, 1);
+                            int dj = path(p, 2);
 
-                        // loop through the voxel-path until the end of a cluster
-                        if (Clusters(h + dh, i + di, j + dj) != label && q < 0) {
-                            q = 0;
-                        }
+                            // loop through the voxel-path until the end of a cluster
+                            if (Clusters(h + dh, i + di, j + dj) != label && q < 0) {
+                                q = 0;
+                            }
 
-                        // loop from the beginning of the path and store there
-                        if (q >= 0) {
-                            if (!Fmask(h + dh, i + di, j + dj)) {
-                                m_norm(
-                                    m_pad[0][0] + path(q, 0),
-                                    m_pad[1][0] + path(q, 1),
-                                    m_pad[1][0] + path(q, 2)) += 1;
-
-                                m_first(
-                                    m_pad[0][0] + path(q, 0),
-                                    m_pad[1][0] + path(q, 1),
-                                    m_pad[1][0] + path(q, 2)) += Fd(h + dh, i + di, j + dj);
+                            // loop from the beginning of the path and store there
+                            if (q >= 0) {
+                                if (!Fmask(h + dh, i + di, j + dj)) {
+                                    size_t k = lag(path(q, 0), path(q, 1), path(q, 2));
+                                    norm[k] += 1;
+                                    first[k] += Fd(h + dh, i + di, j + dj);
+                                }
                             }
-                        }
 
-                        q++;
+                            q++;
+                        }
                     }
                 }
             }
-        }
-    }
+        });
 }
 
 template <class C, class T>
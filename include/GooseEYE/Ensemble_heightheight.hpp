@@ -22,6 +22,10 @@ inline void Ensemble::heightheight(const T& f, const M& fmask)
     GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
     GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::heightheight || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_REQUIRE(!m_autocorrelation || !m_periodic || !xt::any(fmask), std::out_of_range);
+
+    Realization realization(this);
 
     // lock statistic
     m_stat = Type::heightheight;
@@ -36,51 +40,69 @@ inline void Ensemble::heightheight(const T& f, const M& fmask)
         mask_value = 0;
     }
 
-    // apply padding
-    array_type::tensor<double, 3> F = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
-    array_type::tensor<mask_type, 3> Fmask =
-        xt::pad(xt::atleast_3d(fmask), m_pad, xt::pad_mode::constant, mask_value);
-    array_type::tensor<double, 3> Fmaskd =
-        xt::pad(xt::atleast_3d(fmask), m_pad, xt::pad_mode::constant, mask_value);
+    // anchors
+    array_type::tensor<double, 3> F = xt::atleast_3d(f);
+    array_type::tensor<mask_type, 3> Fmask = xt::atleast_3d(fmask);
+
+    // comparison: apply padding
+    array_type::tensor<double, 3> Fp = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
+    array_type::tensor<double, 3> Fmii =
+        1.0 - xt::pad(xt::atleast_3d(fmask), m_pad, xt::pad_mode::constant, mask_value);
 
     // compute correlation
-    for (size_t h = m_pad[0][0]; h < F.shape(0) - m_pad[0][1]; ++h) {
-        for (size_t i = m_pad[1][0]; i < F.shape(1) - m_pad[1][1]; ++i) {
-            for (size_t j = m_pad[2][0]; j < F.shape(2) - m_pad[2][1]; ++j) {
-                // - skip masked
-                if (Fmask(h, i, j)) {
-                    continue;
-                }
-                // - get comparison sub-matrix
-                auto Fi = xt::view(
-                    F,
-                    xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                    xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                    xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - get inverse of comparison mask
-                auto Fmii = 1.0 - xt::view(
-                                      Fmaskd,
-                                      xt::range(h - m_pad[0][0], h + m_pad[0][1] + 1),
-                                      xt::range(i - m_pad[1][0], i + m_pad[1][1] + 1),
-                                      xt::range(j - m_pad[2][0], j + m_pad[2][1] + 1));
-                // - update sum of the m_first moment
-                m_first += xt::pow(Fi - F(h, i, j), 2.0) * Fmii;
-                // - update sum of the m_second moment
-                if (m_variance) {
-                    m_second += xt::pow(Fi - F(h, i, j), 4.0) * Fmii;
-                }
-                // - normalisation
-                m_norm += Fmii;
-            }
-        }
-    }
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, m_variance, true},
+        [&](size_t begin, size_t end, auto first, auto second, auto norm) {
+            detail::stencil::heightheight(
+                geo,
+                begin,
+                end,
+                F.data(),
+                Fmask.data(),
+                Fp.data(),
+                Fmii.data(),
+                first,
+                second,
+                norm);
+        });
 }
 
 template <class T>
 inline void Ensemble::heightheight(const T& f)
 {
-    array_type::array<int> mask = xt::zeros<int>(f.shape());
-    heightheight(f, mask);
+    GOOSEEYE_ASSERT(f.dimension() == m_shape_orig.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(m_stat == Type::heightheight || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+
+    Realization realization(this);
+
+    // lock statistic
+    m_stat = Type::heightheight;
+
+    // not periodic (default): the padded items are skipped
+    // periodic: the padded items are periodic copies
+    xt::pad_mode pad_mode = m_periodic ? xt::pad_mode::periodic : xt::pad_mode::constant;
+
+    // anchors, and padded comparison (no mask)
+    array_type::tensor<double, 3> F = xt::atleast_3d(f);
+    array_type::tensor<double, 3> Fp = xt::pad(xt::atleast_3d(f), m_pad, pad_mode);
+
+    // compute correlation (first and second moment only)
+    detail::stencil::Geometry geo = geometry(F.shape(), m_autocorrelation);
+    this->accumulate(
+        geo.chunks(),
+        {true, m_variance, false},
+        [&](size_t begin, size_t end, auto first, auto second, auto) {
+            detail::stencil::heightheight(
+                geo, m_periodic, begin, end, F.data(), Fp.data(), first, second);
+        });
+
+    // normalisation: analytical without mask
+    this->accumulate(1, {false, false, true}, [&](size_t, size_t, auto, auto, auto norm) {
+        detail::add_overlap(F.shape(), m_pad, m_periodic, norm);
+    });
 }
 
 } // namespace GooseEYE
@@ -16,6 +16,9 @@ void Ensemble::mean(const T& f)
 {
     GOOSEEYE_ASSERT(m_shape == std::vector<size_t>(MAX_DIM, 1), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::mean || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
 
     m_stat = Type::mean;
 
@@ -33,6 +36,9 @@ void Ensemble::mean(const T& f, const M& fmask)
     GOOSEEYE_ASSERT(xt::all(xt::equal(fmask, 0) || xt::equal(fmask, 1)), std::out_of_range);
     GOOSEEYE_ASSERT(m_shape == std::vector<size_t>(MAX_DIM, 1), std::out_of_range);
     GOOSEEYE_ASSERT(m_stat == Type::mean || m_stat == Type::Unset, std::out_of_range);
+    GOOSEEYE_ASSERT(m_accumulator == accumulator::floating, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_autocorrelation, std::out_of_range);
+    GOOSEEYE_ASSERT(!m_radial, std::out_of_range);
 
     m_stat = Type::mean;
 
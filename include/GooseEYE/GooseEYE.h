@@ -96,6 +96,34 @@ enum class path_mode {
     full ///< Similar to actual selecting every voxel that is crossed.
 };
 
+/**
+ * Different methods to compute two-point statistics.
+ * All methods give the same result (up to floating-point rounding), they differ in cost.
+ * A statistic throws for a method that it does not support (as listed below).
+ *
+ * The cost of compute_mode::fft is O(P log P) per correlation, for an image padded with the
+ * 'region-of-interest' and rounded up to a power of two along each axis, such that P is up to
+ * 2x (1d), 4x (2d), or 8x (3d) the padded volume (which also bounds the memory).
+ * C2 needs one correlation per label, O(labels P log P): it falls back to compute_mode::direct
+ * if that is expected to be faster (for many labels, or a small 'region-of-interest').
+ */
+enum class compute_mode {
+    direct, ///< Loop over all pixels, and add the region-of-interest around each pixel.
+    fft, ///< Correlation by discrete Fourier transforms.
+    binary, ///< Count co-occurrences on bit-packed images (images of zeros and ones only).
+    sparse, ///< Loop over the non-zero pixels only (S2, W2), efficient for low volume fractions.
+    unpadded ///< As direct, without padded copies (S2, C2, W2; non-contiguous images are copied).
+};
+
+/**
+ * Type of the accumulators of the raw result of an Ensemble (see Ensemble::set_accumulator()).
+ */
+enum class accumulator {
+    floating, ///< Double precision floating point (default).
+    uint32, ///< 32-bit unsigned integer counters (counting statistics only).
+    uint64 ///< 64-bit unsigned integer counters (counting statistics only).
+};
+
 /**
  * Compute a path between two pixels.
  * @param x0 Pixel coordinate (e.g. {0, 0}).
@@ -1389,6 +1417,69 @@ labels_centers_of_mass(const T& labels, const W& weights, const N& names, bool p
     return ret;
 }
 
+/**
+ * Mask of an image stored as bits: 64 pixels per word, row-by-row along the last axis of
+ * more than one pixel.
+ * It can be used instead of a mask of integers in Ensemble::S2() and Ensemble::C2().
+ * The normalisation of the direct loop is then computed on the packed masks,
+ * counting 64 pixels at once.
+ */
+class PackedMask {
+public:
+    /**
+     * Constructor.
+     */
+    PackedMask() = default;
+
+    /**
+     * Constructor.
+     * @param mask The mask (binary, 1: masked, 0: not masked).
+     */
+    template <class T>
+    PackedMask(const T& mask);
+
+    /**
+     * Shape of the mask.
+     * @return List of size_t.
+     */
+    const std::vector<size_t>& shape() const;
+
+    /**
+     * Check if any pixel is masked.
+     * @return bool
+     */
+    bool any() const;
+
+    /**
+     * Value of a pixel.
+     * @param h Index along the first axis (of the mask as ``xt::atleast_3d``).
+     * @param i Index along the second axis.
+     * @param j Index along the last axis.
+     * @return ``true`` if the pixel is masked.
+     */
+    bool operator()(size_t h, size_t i, size_t j) const;
+
+    /**
+     * Unpack the mask.
+     * @return The mask (1: masked, 0: not masked).
+     */
+    array_type::array<int> unpack() const;
+
+    /**
+     * The packed mask: the pixels of the mask per row along its last axis of more than one
+     * pixel (e.g. one row for a 1d mask), in words of 64 pixels
+     * (first pixel in the least significant bit), followed by one word of zeros.
+     * @return Words.
+     */
+    const std::vector<uint64_t>& data() const;
+
+private:
+    std::vector<size_t> m_shape; ///< Shape of the mask.
+    std::array<size_t, 3> m_shape_3d; ///< Shape in which the mask is packed, see data().
+    size_t m_shift = 0; ///< Trailing axes moved to the front, see detail::binary::roll().
+    std::vector<uint64_t> m_data; ///< Packed mask, see detail::binary::pack().
+};
+
 /**
  * Compute ensemble averaged statistics, by repetitively calling the member-function of a certain
  * statistical measure with different data.
@@ -1414,6 +1505,74 @@ public:
      */
     Ensemble(const std::vector<size_t>& roi, bool periodic = true, bool variance = true);
 
+    /**
+     * Set the number of threads used to loop over the pixels of each image.
+     * Each thread accumulates in private memory, that is added to the ensemble in a fixed order.
+     * The result is therefore reproducible for a fixed number of threads.
+     * The threads are not kept alive: each added realization starts and joins "nthreads - 1"
+     * threads (typically some tens of microseconds each), and allocates, zero-initialises, and
+     * adds "nthreads" private copies of the result (the size of the 'region-of-interest').
+     * Threads therefore only pay off for images that are much larger than the
+     * 'region-of-interest'; many small images are best added on one thread.
+     * @param nthreads Number of threads (default: 1).
+     */
+    void set_threads(size_t nthreads);
+
+    /**
+     * Declare that all realizations are auto-correlations: S2(f, f), C2(f, f), or heightheight(f)
+     * (with equal masks for f and g).
+     * The statistic is then point-symmetric, S(r) = S(-r), such that the direct loops only
+     * compute half of the lags. The other half is mirrored when reading the result.
+     * This requires that images are not periodic or not masked.
+     * Call this before adding any realization.
+     * @param autocorrelation Switch (default: true).
+     */
+    void set_autocorrelation(bool autocorrelation = true);
+
+    /**
+     * Accumulate the statistic per bin of the distance of the lags to the center of the
+     * 'region-of-interest' (see distance()), instead of per lag.
+     * Each lag is added directly to its bin (through a table of the bin of each lag), such that
+     * the accumulators that are allocated while adding a realization (one per thread) scale with
+     * the number of bins.
+     * The result is read using result_radial() and variance_radial().
+     * Call this before adding any realization.
+     * @param h The physical dimensions of one pixel (in each direction).
+     * @param width The width of each bin (in physical dimensions).
+     */
+    void set_radial(const std::vector<double>& h, double width);
+
+    /**
+     * Accumulate the raw result in integer counters, for counting statistics:
+     * S2 (of images of integers), C2, and L.
+     * Each realization is counted directly in 64-bit integers (one buffer per thread),
+     * and then added to the counters, such that the ensemble stays exact for any number of
+     * realizations (up to the range of the counters).
+     * Adding a realization throws if its values are not counts, or if they overflow the counters
+     * (in which case the realization is not added).
+     * Call this before adding any realization.
+     * @param type Type of the accumulators (default: accumulator::floating).
+     */
+    void set_accumulator(accumulator type);
+
+    /**
+     * Traverse the anchors and the lags of the direct loops (S2, C2, W2, heightheight) in tiles,
+     * such that the part of the padded comparison image and of the result that is used by one
+     * tile stays in cache. A tile covers a block of anchors along the last axis and a block of
+     * rows of lags of the 'region-of-interest'. The result does not depend on the tiles.
+     * A number of anchors (or rows) that exceeds the image (or the 'region-of-interest') only
+     * puts all anchors (or rows) in one tile: the other dimension is still tiled.
+     * The automatic choice fits the tile in "cache" bytes. The default, 256 kB, is the private
+     * (L2) cache of one core on many (older) x86 machines: each thread runs its own tiles, such
+     * that the cache that is shared between cores does not count, while the L1 cache (32-48 kB)
+     * only holds a handful of rows of lags. Use the L2 size per core of the machine at hand
+     * (e.g. 1-2 MB on recent x86 and ARM cores) to get fewer, larger tiles.
+     * @param anchors Number of anchors per tile (default: 0, automatic).
+     * @param rows Number of rows of lags per tile (default: 0, automatic).
+     * @param cache Size of the cache in bytes for the automatic choice (default: 256 kB).
+     */
+    void set_tiles(size_t anchors = 0, size_t rows = 0, size_t cache = 262144);
+
     /**
      * Get ensemble average.
      * @return The average along the 'region-of-interest' set at construction.
@@ -1421,11 +1580,38 @@ public:
     array_type::array<double> result() const;
 
     /**
-     * Get ensemble variance.
+     * Get ensemble variance (unbiased, zero for lags with fewer than two samples).
      * @return The variance along the 'region-of-interest' set at construction.
      */
     array_type::array<double> variance() const;
 
+    /**
+     * Get the standard error of the ensemble average, for realizations added using S2_sampled():
+     * sqrt(variance() / norm()), with the variance of f(i) * g(i + di) over the sampled anchors.
+     * Lags with fewer than two samples have no estimate of the error: their error is zero.
+     * @return The standard error along the 'region-of-interest' set at construction.
+     */
+    array_type::array<double> standard_error() const;
+
+    /**
+     * Get ensemble average, per bin of the distance (see set_radial()).
+     * @return The average per bin.
+     */
+    array_type::array<double> result_radial() const;
+
+    /**
+     * Get ensemble variance, per bin of the distance (see set_radial()).
+     * Bins with fewer than two samples have variance zero.
+     * @return The variance per bin.
+     */
+    array_type::array<double> variance_radial() const;
+
+    /**
+     * Get the distance at the center of each bin (see set_radial()).
+     * @return The distance per bin.
+     */
+    array_type::array<double> distance_radial() const;
+
     /**
      * Get raw-data: ensemble sum of the first moment: x_1 + x_2 + ...
      * @return The sum along the 'region-of-interest' set at construction.
@@ -1476,6 +1662,52 @@ public:
      */
     array_type::array<double> distance(const std::vector<double>& h, size_t axis) const;
 
+    /**
+     * Add the realizations of another ensemble (e.g. computed by another process).
+     * The ensembles have to be of the same statistic (or not locked), region-of-interest,
+     * periodicity, variance, and (if set) auto-correlation, radial bins, and accumulator.
+     * The settings that do not affect the result (threads, tiles) are not merged.
+     * @param other The ensemble to add.
+     */
+    void merge(const Ensemble& other);
+
+    /**
+     * Add the realizations of another ensemble, see merge().
+     * @param other The ensemble to add.
+     * @return Reference to this ensemble.
+     */
+    Ensemble& operator+=(const Ensemble& other);
+
+    /**
+     * Write the ensemble (its settings and raw data) in a versioned binary format
+     * (in the byte order of the machine, that is marked in the header).
+     * The state of S2_slab() and S2_incremental() is not written.
+     * @param stream Output stream (opened in binary mode).
+     */
+    void save(std::ostream& stream) const;
+
+    /**
+     * Write the ensemble to a file, see save(std::ostream&).
+     * @param filename Name of the file.
+     */
+    void save(const std::string& filename) const;
+
+    /**
+     * Read an ensemble written by save().
+     * Throws if the data is not consistent, or if it was written on a machine with a different
+     * byte order.
+     * @param stream Input stream (opened in binary mode).
+     * @return The ensemble.
+     */
+    static Ensemble load(std::istream& stream);
+
+    /**
+     * Read an ensemble from a file, see load(std::istream&).
+     * @param filename Name of the file.
+     * @return The ensemble.
+     */
+    static Ensemble load(const std::string& filename);
+
     /**
      * Add realization to arithmetic mean.
      * @param f The image.
@@ -1495,9 +1727,10 @@ public:
      * Add realization to 2-point correlation: P(f(i) * g(i + di)).
      * @param f The image.
      * @param g The comparison image.
+     * @param mode Method to use (see "compute_mode").
      */
     template <class T>
-    void S2(const T& f, const T& g);
+    void S2(const T& f, const T& g, compute_mode mode = compute_mode::direct);
 
     /**
      * Add realization to 2-point correlation: P(f(i) * g(i + di)).
@@ -1505,17 +1738,172 @@ public:
      * @param g The comparison image.
      * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
      * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     * @param mode Method to use (see "compute_mode").
      */
     template <class T, class M>
-    void S2(const T& f, const T& g, const M& fmask, const M& gmask);
+    void
+    S2(const T& f,
+       const T& g,
+       const M& fmask,
+       const M& gmask,
+       compute_mode mode = compute_mode::direct);
+
+    /**
+     * @copydoc S2(const T&, const T&, const M&, const M&, compute_mode)
+     */
+    template <class T>
+    void
+    S2(const T& f,
+       const T& g,
+       const PackedMask& fmask,
+       const PackedMask& gmask,
+       compute_mode mode = compute_mode::direct);
+
+    /**
+     * Add a stack of realizations to 2-point correlation: P(f(i) * g(i + di)).
+     * This is equivalent to calling S2() for each sample, but memory and transforms are reused,
+     * and the samples are distributed over the threads (see set_threads()).
+     * @param f The images, stacked along the first axis.
+     * @param g The comparison images, stacked along the first axis.
+     * @param mode Method to use (see "compute_mode").
+     */
+    template <class T>
+    void S2_batch(const T& f, const T& g, compute_mode mode = compute_mode::direct);
+
+    /**
+     * Add a stack of realizations to 2-point correlation: P(f(i) * g(i + di)).
+     * This is equivalent to calling S2() for each sample, but memory and transforms are reused,
+     * and the samples are distributed over the threads (see set_threads()).
+     * @param f The images, stacked along the first axis.
+     * @param g The comparison images, stacked along the first axis.
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     * @param mode Method to use (see "compute_mode").
+     */
+    template <class T, class M>
+    void S2_batch(
+        const T& f,
+        const T& g,
+        const M& fmask,
+        const M& gmask,
+        compute_mode mode = compute_mode::direct);
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)),
+     * for a (small) two-dimensional region-of-interest {Rx, Ry} that is known at compile time
+     * (it must be the region-of-interest of the ensemble).
+     * The lags are accumulated on the stack without padding the image, and the normalisation
+     * is analytical, such that the overhead per image is small (for many small images).
+     * @tparam Rx Shape of the region-of-interest along the first axis.
+     * @tparam Ry Shape of the region-of-interest along the second axis.
+     * @param f The image (read in-place if row-major, copied otherwise).
+     * @param g The comparison image (read in-place if row-major, copied otherwise).
+     */
+    template <size_t Rx, size_t Ry, class T>
+    void S2(const T& f, const T& g);
+
+    /**
+     * Add a slab of a realization to 2-point correlation: P(f(i) * g(i + di)).
+     * The realization is streamed as consecutive slabs along the first axis (of any thickness),
+     * such that only a window of slabs has to be kept in memory (plus the first slabs if
+     * periodic). Close the realization with S2_slab_end().
+     * The result is the same as adding the full image with S2() (up to the order in which
+     * contributions are summed if periodic).
+     * Requires images of at least two dimensions.
+     * @param f The slab of the image.
+     * @param g The slab of the comparison image.
+     */
+    template <class T>
+    void S2_slab(const T& f, const T& g);
+
+    /**
+     * Add a slab of a realization to 2-point correlation: P(f(i) * g(i + di)).
+     * See S2_slab(const T&, const T&).
+     * @param f The slab of the image.
+     * @param g The slab of the comparison image.
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     */
+    template <class T, class M>
+    void S2_slab(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    /**
+     * Close a realization that was streamed using S2_slab().
+     */
+    void S2_slab_end();
+
+    /**
+     * Add realization to 2-point correlation of an image with itself: P(f(i) * f(i + di)),
+     * and keep the image and its correlation to add changed versions of it using S2_update().
+     * @param f The image.
+     */
+    template <class T>
+    void S2_incremental(const T& f);
+
+    /**
+     * Add realization to 2-point correlation of an image with itself: P(f(i) * f(i + di)),
+     * and keep the image and its correlation to add changed versions of it using S2_update().
+     * @param f The image.
+     * @param mask Mask certain pixels (binary, 1: masked, 0: not masked), fixed for all updates.
+     */
+    template <class T, class M>
+    void S2_incremental(const T& f, const M& mask);
+
+    /**
+     * Change pixels of the image set by S2_incremental() and add the changed image as
+     * realization. The correlation is updated in O(changes * roi) (instead of recomputed in
+     * O(image * roi)). It equals a full recompute exactly if all sums are exactly representable
+     * (e.g. for integer images), and up to rounding otherwise.
+     * @param index Flat index of each changed pixel (each pixel at most once).
+     * @param old Old value of each changed pixel (must correspond to the current image).
+     * @param value New value of each changed pixel.
+     */
+    template <class I, class T>
+    void S2_update(const I& index, const T& old, const T& value);
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)), estimated from a random
+     * sample of anchors i (drawn uniformly with replacement), such that the cost scales with
+     * the number of samples instead of with the size of the image. The ensemble is then locked
+     * to sampled realizations, and standard_error() estimates the error of result().
+     * @param f The image (read in-place if row-major, copied otherwise).
+     * @param g The comparison image (read in-place if row-major, copied otherwise).
+     * @param samples Number of anchors to draw.
+     * @param seed Seed of the random number generator (use a different seed per realization).
+     */
+    template <class T>
+    void S2_sampled(const T& f, const T& g, size_t samples, uint64_t seed = 0);
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)), estimated from a random
+     * sample of anchors i (drawn uniformly with replacement), such that the cost scales with
+     * the number of samples instead of with the size of the image. The ensemble is then locked
+     * to sampled realizations, and standard_error() estimates the error of result().
+     * @param f The image (read in-place if row-major, copied otherwise).
+     * @param g The comparison image (read in-place if row-major, copied otherwise).
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     *     Masked anchors that are drawn are skipped.
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     * @param samples Number of anchors to draw.
+     * @param seed Seed of the random number generator (use a different seed per realization).
+     */
+    template <class T, class M>
+    void S2_sampled(
+        const T& f,
+        const T& g,
+        const M& fmask,
+        const M& gmask,
+        size_t samples,
+        uint64_t seed = 0);
 
     /**
      * Add realization to 2-point cluster function: P(f(i) == g(i + di)).
      * @param f The image.
      * @param g The comparison image.
+     * @param mode Method to use (see "compute_mode").
      */
     template <class T>
-    void C2(const T& f, const T& g);
+    void C2(const T& f, const T& g, compute_mode mode = compute_mode::direct);
 
     /**
      * Add realization to 2-point cluster function: P(f(i) == g(i + di)).
@@ -1523,26 +1911,74 @@ public:
      * @param g The comparison image.
      * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
      * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     * @param mode Method to use (see "compute_mode").
      */
     template <class T, class M>
-    void C2(const T& f, const T& g, const M& fmask, const M& gmask);
+    void
+    C2(const T& f,
+       const T& g,
+       const M& fmask,
+       const M& gmask,
+       compute_mode mode = compute_mode::direct);
+
+    /**
+     * @copydoc C2(const T&, const T&, const M&, const M&, compute_mode)
+     */
+    template <class T>
+    void
+    C2(const T& f,
+       const T& g,
+       const PackedMask& fmask,
+       const PackedMask& gmask,
+       compute_mode mode = compute_mode::direct);
+
+    /**
+     * Add a stack of realizations to 2-point cluster function: P(f(i) == g(i + di)).
+     * This is equivalent to calling C2() for each sample, but memory and transforms are reused,
+     * and the samples are distributed over the threads (see set_threads()).
+     * @param f The images, stacked along the first axis.
+     * @param g The comparison images, stacked along the first axis.
+     * @param mode Method to use (see "compute_mode").
+     */
+    template <class T>
+    void C2_batch(const T& f, const T& g, compute_mode mode = compute_mode::direct);
+
+    /**
+     * Add a stack of realizations to 2-point cluster function: P(f(i) == g(i + di)).
+     * This is equivalent to calling C2() for each sample, but memory and transforms are reused,
+     * and the samples are distributed over the threads (see set_threads()).
+     * @param f The images, stacked along the first axis.
+     * @param g The comparison images, stacked along the first axis.
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     * @param mode Method to use (see "compute_mode").
+     */
+    template <class T, class M>
+    void C2_batch(
+        const T& f,
+        const T& g,
+        const M& fmask,
+        const M& gmask,
+        compute_mode mode = compute_mode::direct);
 
     /**
      * Add realization to weighted 2-point correlation.
      * @param w The weights.
      * @param f The image.
+     * @param mode Method to use (see "compute_mode"): direct, sparse, or unpadded.
      */
     template <class T>
-    void W2(const T& w, const T& f);
+    void W2(const T& w, const T& f, compute_mode mode = compute_mode::direct);
 
     /**
      * Add realization to weighted 2-point correlation.
      * @param w The weights.
      * @param f The image.
      * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param mode Method to use (see "compute_mode"): direct, sparse, or unpadded.
      */
     template <class T, class M>
-    void W2(const T& w, const T& f, const M& fmask);
+    void W2(const T& w, const T& f, const M& fmask, compute_mode mode = compute_mode::direct);
 
     /**
      * Add realization to collapsed weighted 2-point correlation
@@ -1597,8 +2033,166 @@ public:
     void L(const T& f, path_mode mode = path_mode::Bresenham);
 
 private:
+    // Copy of an accumulated quantity, with the lags of auto-correlations filled by symmetry.
+    array_type::tensor<double, 3> mirrored(const array_type::tensor<double, 3>& a) const;
+
+    // Start adding a realization (radial: zero "m_radial_pending";
+    // integer accumulators: zero "m_counts_pending").
+    void begin_realization();
+
+    // Finish adding a realization (radial: add "m_radial_pending" to the bins, unless "discard";
+    // integer accumulators: add "m_counts_pending" to the counters, unless "discard").
+    void end_realization(bool discard);
+
+    // Run "kernel(begin, end, first, second, norm)" on the items "[0, n)" (in parallel, see
+    // "detail::thread::accumulate"). The kernel adds to the lags of the selected "moments"
+    // (first, second, norm) through outputs that behave as pointers to all lags
+    // ("double*", "detail::output::Bins" if radial, or "detail::output::Counts" if integer
+    // accumulators are used); the others are null.
+    // Integer accumulators: throws if the realization no longer fits in the counters.
+    template <class K>
+    void accumulate(size_t n, const std::array<bool, 3>& moments, K kernel);
+
+    // Check that the realization in "m_counts_pending" fits in integer counters.
+    template <class R>
+    bool fits(const std::array<array_type::tensor<R, 3>, 3>& counts) const;
+
+    // Add the realization in "m_counts_pending" to integer counters (that it fits, see "fits").
+    template <class R>
+    void add_counts(std::array<array_type::tensor<R, 3>, 3>& counts) const;
+
+    // Add the integer counters of another ensemble.
+    // Returns false (and adds nothing) if the sums do not fit in the counters.
+    template <class R>
+    static bool merge_counts(
+        std::array<array_type::tensor<R, 3>, 3>& counts,
+        const std::array<array_type::tensor<R, 3>, 3>& other);
+
+    // Raw result (mirrored, see "mirrored"): 0: "m_first", 1: "m_second", or 2: "m_norm",
+    // from the counters if integer accumulators are used.
+    array_type::tensor<double, 3> raw(size_t moment) const;
+
+    // Scope of adding a realization, see "begin_realization" and "end_realization".
+    // The realization is discarded if an exception is thrown while adding it.
+    // Finishing the realization does not throw: integer counters are checked while adding.
+    class Realization {
+    public:
+        explicit Realization(Ensemble* ensemble)
+            : m_ensemble(ensemble), m_exceptions(std::uncaught_exceptions())
+        {
+            m_ensemble->begin_realization();
+        }
+
+        ~Realization()
+        {
+            m_ensemble->end_realization(std::uncaught_exceptions() > m_exceptions);
+        }
+
+        Realization(const Realization&) = delete;
+        Realization& operator=(const Realization&) = delete;
+
+    private:
+        Ensemble* m_ensemble;
+        int m_exceptions;
+    };
+
+    // Set the bin of each lag of the region-of-interest (see "set_radial", "m_bins").
+    void set_bins();
+
+    // Geometry of the direct loops over an image of a certain shape (3d), in tiles if requested
+    // (see "set_tiles"). Skips lags that follow by symmetry if "symmetric".
+    template <class S>
+    detail::stencil::Geometry geometry(const S& shape, bool symmetric) const;
+
+    // Realization that is streamed in slabs along the first axis (see "S2_slab").
+    // The rows (along the first axis) "[offset, rows)" are stored in the window,
+    // and, if periodic, the first "pad[0][0] + pad[0][1]" rows are stored in the head.
+    struct Slabs {
+        std::array<size_t, 3> shape = {0, 0, 0}; // shape of the image (3d), "shape[0]" not used
+        size_t rows = 0; // number of rows received
+        size_t done = 0; // number of rows of anchors that are processed
+        size_t offset = 0; // first row in the window
+        size_t head = 0; // number of rows in the head
+        std::vector<double> f; // window: image
+        std::vector<double> g; // window: comparison image
+        std::vector<uint8_t> fmask; // window: mask of the image
+        std::vector<uint8_t> gmask; // window: mask of the comparison image
+        std::vector<double> head_f; // head: image
+        std::vector<double> head_g; // head: comparison image
+        std::vector<uint8_t> head_fmask; // head: mask of the image
+        std::vector<uint8_t> head_gmask; // head: mask of the comparison image
+    };
+
+    // Image that is tracked to update its correlation incrementally (see "S2_incremental").
+    struct Incremental {
+        array_type::tensor<double, 3> F; // image
+        array_type::tensor<int, 3> Fmask; // mask of the image
+        array_type::tensor<double, 3> G; // padded comparison image, multiplied by "Gmii"
+        array_type::tensor<double, 3> Gmii; // inverse of the padded comparison mask
+        array_type::tensor<double, 3> first; // correlation of the image
+        array_type::tensor<double, 3> norm; // normalisation of the image
+        std::array<std::vector<std::vector<size_t>>, 3> copies; // per axis: padded items of item
+    };
+
+    // Change one pixel of the tracked image, and update its correlation (see "S2_update").
+    void S2_change(size_t index, double value);
+
+    // Process the anchors for which all rows are available (or all remaining anchors at the end).
+    void S2_slab_process(bool end);
+
+    // Add the correlation of the rows of anchors "[begin, end)" of the streamed realization.
+    void S2_slab_anchors(size_t begin, size_t end);
+
+    // Add realization to 2-point correlation, using FFTs (periodic, not masked).
+    template <class T>
+    void S2_fft(const T& f, const T& g);
+
+    // Add realization to 2-point correlation, using FFTs (zero-padded, masked).
+    template <class T, class M>
+    void S2_fft(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    // Add realization to 2-point correlation, using bit-packed images (of zeros and ones).
+    template <class T, class M>
+    void S2_binary(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    // Add realization to 2-point correlation, looping over the non-zero anchors only.
+    template <class T, class M>
+    void S2_sparse(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    // Add realization to 2-point correlation, reading the images through index tables.
+    template <class T, class M>
+    void S2_unpadded(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    // Add realization to 2-point cluster function, using FFTs (one correlation per label).
+    template <class T, class M>
+    void C2_fft(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    // Add realization to 2-point cluster function, reading the images through index tables.
+    template <class T, class M>
+    void C2_unpadded(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    // Add realization to weighted 2-point correlation, reading the images through index tables.
+    template <class T, class M>
+    void W2_unpadded(const T& f, const T& g, const M& gmask);
+
     // Type: used to lock the ensemble to a certain measure.
-    enum class Type { Unset, mean, S2, C2, W2, W2c, L, heightheight };
+    enum class Type { Unset, mean, S2, S2_sampled, C2, W2, W2c, L, heightheight };
+
+    // Codes of "Type" and "accumulator" in files (see "save"): the index in these lists.
+    // N.B. Append new items, never reorder or remove items (that would change old files).
+    static constexpr std::array<Type, 9> STAT_CODES = {
+        Type::Unset,
+        Type::mean,
+        Type::S2,
+        Type::S2_sampled,
+        Type::C2,
+        Type::W2,
+        Type::W2c,
+        Type::L,
+        Type::heightheight};
+
+    static constexpr std::array<accumulator, 3> ACCUMULATOR_CODES = {
+        accumulator::floating, accumulator::uint32, accumulator::uint64};
 
     // Initialize class as unlocked.
     Type m_stat = Type::Unset;
@@ -1612,6 +2206,57 @@ private:
     // Switch to compute the variance (for the entire ensemble).
     bool m_variance;
 
+    // Number of threads used to loop over the pixels of each image.
+    size_t m_nthreads = 1;
+
+    // Realizations are auto-correlations: only half of the lags is computed.
+    bool m_autocorrelation = false;
+
+    // Traverse the direct loops in tiles (see "set_tiles"): anchors and rows of lags per tile.
+    bool m_tiled = false;
+    std::array<size_t, 2> m_tiles = {0, 0};
+    size_t m_cache = 262144;
+
+    // Accumulate per bin of the distance of the lags (see "set_radial").
+    bool m_radial = false;
+
+    // Physical dimensions of one pixel (3d), and width of the bins.
+    std::array<double, 3> m_h = {1.0, 1.0, 1.0};
+    double m_width = 1.0;
+
+    // Raw result per bin: as "m_first", "m_second", and "m_norm".
+    array_type::tensor<double, 1> m_radial_first;
+    array_type::tensor<double, 1> m_radial_second;
+    array_type::tensor<double, 1> m_radial_norm;
+
+    // Bin of each lag (flat index in the region-of-interest), for "n" bins.
+    // Auto-correlations: the lags that follow by symmetry (see "set_autocorrelation") are put
+    // in bin "2 n" (not used), the lags from which they follow in bin "n + b" (counted twice).
+    std::vector<size_t> m_bins;
+
+    // Realization that is being added, per bin of "m_bins": as "m_first", "m_second", "m_norm".
+    std::array<std::vector<double>, 3> m_radial_pending;
+
+    // Number of (nested) calls that are adding a realization.
+    size_t m_depth = 0;
+
+    // Type of the accumulators (see "set_accumulator").
+    accumulator m_accumulator = accumulator::floating;
+
+    // Raw result as integer counters (see "set_accumulator"), as "m_first", "m_second", "m_norm".
+    // Only the counters of the selected type are allocated.
+    std::array<array_type::tensor<uint32_t, 3>, 3> m_counts32;
+    std::array<array_type::tensor<uint64_t, 3>, 3> m_counts64;
+
+    // Realization that is being counted (integer accumulators), as "m_counts32" or "m_counts64".
+    std::array<std::vector<uint64_t>, 3> m_counts_pending;
+
+    // Realization that is being streamed (see "S2_slab").
+    Slabs m_slabs;
+
+    // Image of which the correlation is updated incrementally (see "S2_incremental").
+    Incremental m_incremental;
+
     // Raw (not normalized) result, and normalization:
     // - sum of the first moment: x_1 + x_2 + ...
     array_type::tensor<double, 3> m_first;
@@ -1630,6 +2275,223 @@ private:
     std::vector<std::vector<size_t>> m_pad;
 };
 
+/**
+ * Compute ensemble averaged statistics for a list of lags (instead of for all lags of a
+ * 'region-of-interest', as Ensemble), with the same masking and periodicity.
+ * The memory and the cost scale with the number of lags.
+ */
+class EnsembleLags {
+public:
+    /**
+     * Constructor.
+     */
+    EnsembleLags() = default;
+
+    /**
+     * Constructor.
+     * @param lags List of lags [n_lags, ndim], with ndim the number of dimensions of the images.
+     * @param periodic Switch to assume image periodic.
+     */
+    EnsembleLags(const array_type::tensor<ptrdiff_t, 2>& lags, bool periodic = true);
+
+    /**
+     * Set the number of threads used to loop over the pixels of each image (see Ensemble).
+     * @param nthreads Number of threads (default: 1).
+     */
+    void set_threads(size_t nthreads);
+
+    /**
+     * Get the list of lags.
+     * @return The lags [n_lags, ndim], as set at construction.
+     */
+    array_type::tensor<ptrdiff_t, 2> lags() const;
+
+    /**
+     * Get ensemble average.
+     * @return The average for each lag [n_lags].
+     */
+    array_type::tensor<double, 1> result() const;
+
+    /**
+     * Get raw-data: ensemble sum of the first moment: x_1 + x_2 + ...
+     * @return The sum for each lag [n_lags].
+     */
+    array_type::tensor<double, 1> data_first() const;
+
+    /**
+     * Get raw-data: normalisation (number of measurements per lag).
+     * @return The norm for each lag [n_lags].
+     */
+    array_type::tensor<double, 1> norm() const;
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)).
+     * @param f The image.
+     * @param g The comparison image.
+     */
+    template <class T>
+    void S2(const T& f, const T& g);
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)).
+     * @param f The image.
+     * @param g The comparison image.
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     */
+    template <class T, class M>
+    void S2(const T& f, const T& g, const M& fmask, const M& gmask);
+
+    /**
+     * Add realization to 2-point cluster function: P(f(i) == g(i + di)).
+     * @param f The image.
+     * @param g The comparison image.
+     */
+    template <class T>
+    void C2(const T& f, const T& g);
+
+    /**
+     * Add realization to 2-point cluster function: P(f(i) == g(i + di)).
+     * @param f The image.
+     * @param g The comparison image.
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     */
+    template <class T, class M>
+    void C2(const T& f, const T& g, const M& fmask, const M& gmask);
+
+private:
+    // Type: used to lock the ensemble to a certain measure.
+    enum class Type { Unset, S2, C2 };
+
+    // Initialize class as unlocked.
+    Type m_stat = Type::Unset;
+
+    // Switch to assume periodicity (for the entire ensemble).
+    bool m_periodic = true;
+
+    // Number of threads used to loop over the pixels of each image.
+    size_t m_nthreads = 1;
+
+    // Lags, as specified [n_lags, ndim].
+    array_type::tensor<ptrdiff_t, 2> m_lags_orig;
+
+    // 3d equivalent of "m_lags_orig" (as "xt::atleast_3d" of the images) [n_lags, 3].
+    array_type::tensor<ptrdiff_t, 2> m_lags;
+
+    // Pad size (3d), see "detail::stencil::pad_width_lags".
+    std::vector<std::vector<size_t>> m_pad;
+
+    // Raw (not normalized) result, and normalization (per lag).
+    array_type::tensor<double, 1> m_first;
+    array_type::tensor<double, 1> m_norm;
+};
+
+/**
+ * Compute ensemble averaged 2-point correlations for long-range lags at a fraction of the cost,
+ * using a pyramid of images that are coarsened by block averaging (by a factor two per level).
+ * Level 0 computes all lags of the 'region-of-interest' at full resolution.
+ * Each next level computes the lags of the 'region-of-interest' on the coarsened image,
+ * skipping those that are covered by the previous level. This gives lags whose spacing doubles
+ * with each level, up to the 'region-of-interest' times 2^(levels - 1) (in pixels of the image).
+ * Each lag is normalised by the number of (coarse) pairs of pixels that it measures.
+ * The result for coarse lags is an approximation: the correlation of the block-averaged image.
+ * If periodic, the shape of the image must be divisible by 2^(levels - 1) along each axis
+ * (of more than one pixel), such that the blocks tile the image and each coarse image is periodic.
+ */
+class EnsembleMultiscale {
+public:
+    /**
+     * Constructor.
+     */
+    EnsembleMultiscale() = default;
+
+    /**
+     * Constructor.
+     * @param roi Shape of the 'region-of-interest' (in pixels of the image at each level).
+     * @param levels Number of levels (1: only the full resolution).
+     * @param periodic Switch to assume image periodic.
+     */
+    EnsembleMultiscale(const std::vector<size_t>& roi, size_t levels, bool periodic = true);
+
+    /**
+     * Set the number of threads used to loop over the pixels of each image (see Ensemble).
+     * @param nthreads Number of threads (default: 1).
+     */
+    void set_threads(size_t nthreads);
+
+    /**
+     * Get the lags (in pixels of the image at full resolution), ordered by level.
+     * @return The lags [n_lags, ndim].
+     */
+    array_type::tensor<ptrdiff_t, 2> lags() const;
+
+    /**
+     * Get the level at which each lag is computed (see lags()).
+     * @return The level of each lag [n_lags].
+     */
+    array_type::tensor<size_t, 1> level() const;
+
+    /**
+     * Get ensemble average.
+     * @return The average for each lag [n_lags] (see lags()).
+     */
+    array_type::tensor<double, 1> result() const;
+
+    /**
+     * Get raw-data: ensemble sum of the first moment: x_1 + x_2 + ...
+     * @return The sum for each lag [n_lags] (see lags()).
+     */
+    array_type::tensor<double, 1> data_first() const;
+
+    /**
+     * Get raw-data: normalisation (number of measurements per lag).
+     * @return The norm for each lag [n_lags] (see lags()).
+     */
+    array_type::tensor<double, 1> norm() const;
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)).
+     * Throws if periodic and the shape of the image is not divisible by 2^(levels - 1).
+     * @param f The image.
+     * @param g The comparison image.
+     */
+    template <class T>
+    void S2(const T& f, const T& g);
+
+    /**
+     * Add realization to 2-point correlation: P(f(i) * g(i + di)).
+     * A coarse pixel is masked if all pixels of its block are masked.
+     * Throws if periodic and the shape of the image is not divisible by 2^(levels - 1).
+     * @param f The image.
+     * @param g The comparison image.
+     * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
+     * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
+     */
+    template <class T, class M>
+    void S2(const T& f, const T& g, const M& fmask, const M& gmask);
+
+private:
+    // Concatenate a quantity of all levels.
+    template <class F>
+    array_type::tensor<double, 1> concatenate(F func) const;
+
+    // Number of dimensions of the images.
+    size_t m_ndim = 0;
+
+    // Switch to assume the images periodic.
+    bool m_periodic = true;
+
+    // Per level: lags of that level (in pixels of that level, 3d).
+    std::vector<EnsembleLags> m_levels;
+
+    // Lags of all levels (in pixels of the image) [n_lags, ndim].
+    array_type::tensor<ptrdiff_t, 2> m_lags;
+
+    // Level of each lag [n_lags].
+    array_type::tensor<size_t, 1> m_level;
+};
+
 // ---------------------------------------------------------
 // Wrapper functions to compute the statistics for one image
 // ---------------------------------------------------------
@@ -1672,9 +2534,15 @@ inline auto distance(const std::vector<size_t>& roi, const std::vector<double>&
  * @param f The image.
  * @param g The comparison image.
  * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see compute_mode()).
  */
 template <class T>
-inline auto S2(const std::vector<size_t>& roi, const T& f, const T& g, bool periodic = true);
+inline auto
+S2(const std::vector<size_t>& roi,
+   const T& f,
+   const T& g,
+   bool periodic = true,
+   compute_mode mode = compute_mode::direct);
 
 /**
  * 2-point correlation: P(f(i) * g(i + di)).
@@ -1684,6 +2552,7 @@ inline auto S2(const std::vector<size_t>& roi, const T& f, const T& g, bool peri
  * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
  * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
  * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see compute_mode()).
  */
 template <class T, class M>
 inline auto
@@ -1692,7 +2561,39 @@ S2(const std::vector<size_t>& roi,
    const T& g,
    const M& fmask,
    const M& gmask,
-   bool periodic = true);
+   bool periodic = true,
+   compute_mode mode = compute_mode::direct);
+
+/**
+ * 2-point correlation: P(f(i) * g(i + di)),
+ * for a (small) two-dimensional region-of-interest {Rx, Ry} that is known at compile time.
+ * @tparam Rx Shape of the region-of-interest along the first axis.
+ * @tparam Ry Shape of the region-of-interest along the second axis.
+ * @param f The image (read in-place if row-major, copied otherwise).
+ * @param g The comparison image (read in-place if row-major, copied otherwise).
+ * @param periodic Switch to assume image periodic.
+ */
+template <size_t Rx, size_t Ry, class T>
+inline auto S2(const T& f, const T& g, bool periodic = true);
+
+/**
+ * 2-point correlation of all pairs of phases: P(labels(i) == a and labels(i + di) == b).
+ * This is equivalent to ``S2(roi, labels == a, labels == b, periodic)`` for all "a" and "b",
+ * but computed in one pass over the image (or with "nphases" transforms per image).
+ * @param roi Region-of-interest.
+ * @param labels The phase of each pixel (0, 1, ..., nphases - 1).
+ * @param nphases The number of phases.
+ * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see compute_mode(): direct or fft, other modes throw).
+ * @return The correlations [nphases, nphases, roi...].
+ */
+template <class T>
+inline array_type::array<double> S2_matrix(
+    const std::vector<size_t>& roi,
+    const T& labels,
+    size_t nphases,
+    bool periodic = true,
+    compute_mode mode = compute_mode::direct);
 
 /**
  * 2-point cluster function: P(f(i) == g(i + di)).
@@ -1700,9 +2601,15 @@ S2(const std::vector<size_t>& roi,
  * @param f The image.
  * @param g The comparison image.
  * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see compute_mode()).
  */
 template <class T>
-inline auto C2(const std::vector<size_t>& roi, const T& f, const T& g, bool periodic = true);
+inline auto
+C2(const std::vector<size_t>& roi,
+   const T& f,
+   const T& g,
+   bool periodic = true,
+   compute_mode mode = compute_mode::direct);
 
 /**
  * 2-point cluster function: P(f(i) == g(i + di)).
@@ -1712,6 +2619,7 @@ inline auto C2(const std::vector<size_t>& roi, const T& f, const T& g, bool peri
  * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
  * @param gmask Mask certain pixels of g (binary, 1: masked, 0: not masked).
  * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see compute_mode()).
  */
 template <class T, class M>
 inline auto
@@ -1720,7 +2628,8 @@ C2(const std::vector<size_t>& roi,
    const T& g,
    const M& fmask,
    const M& gmask,
-   bool periodic = true);
+   bool periodic = true,
+   compute_mode mode = compute_mode::direct);
 
 /**
  * Weighted 2-point correlation.
@@ -1728,9 +2637,15 @@ C2(const std::vector<size_t>& roi,
  * @param w Weights.
  * @param f The image.
  * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see "compute_mode"): direct or sparse.
  */
 template <class T>
-inline auto W2(const std::vector<size_t>& roi, const T& w, const T& f, bool periodic = true);
+inline auto W2(
+    const std::vector<size_t>& roi,
+    const T& w,
+    const T& f,
+    bool periodic = true,
+    compute_mode mode = compute_mode::direct);
 
 /**
  * Weighted 2-point correlation.
@@ -1739,10 +2654,16 @@ inline auto W2(const std::vector<size_t>& roi, const T& w, const T& f, bool peri
  * @param f The image.
  * @param fmask Mask certain pixels of f (binary, 1: masked, 0: not masked).
  * @param periodic Switch to assume image periodic.
+ * @param mode Method to use (see "compute_mode"): direct or sparse.
  */
 template <class T, class M>
 inline auto
-W2(const std::vector<size_t>& roi, const T& w, const T& f, const M& fmask, bool periodic = true);
+W2(const std::vector<size_t>& roi,
+   const T& w,
+   const T& f,
+   const M& fmask,
+   bool periodic = true,
+   compute_mode mode = compute_mode::direct);
 
 /**
  * Collapsed weighted 2-point correlation
@@ -1826,6 +2747,9 @@ L(const std::vector<size_t>& roi,
 #include "Ensemble_W2c.hpp"
 #include "Ensemble_heightheight.hpp"
 #include "Ensemble_mean.hpp"
+#include "EnsembleLags.hpp"
+#include "EnsembleMultiscale.hpp"
 #include "GooseEYE.hpp"
+#include "PackedMask.hpp"
 
 #endif
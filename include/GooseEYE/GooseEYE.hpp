@@ -50,10 +50,19 @@ inline auto distance(const std::vector<size_t>& roi, const std::vector<double>&
 }
 
 template <class T>
-inline auto S2(const std::vector<size_t>& roi, const T& f, const T& g, bool periodic)
+inline auto
+S2(const std::vector<size_t>& roi, const T& f, const T& g, bool periodic, compute_mode mode)
 {
     Ensemble ensemble(roi, periodic);
-    ensemble.S2(f, g);
+    ensemble.S2(f, g, mode);
+    return ensemble.result();
+}
+
+template <size_t Rx, size_t Ry, class T>
+inline auto S2(const T& f, const T& g, bool periodic)
+{
+    Ensemble ensemble({Rx, Ry}, periodic);
+    ensemble.S2<Rx, Ry>(f, g);
     return ensemble.result();
 }
 
@@ -64,18 +73,109 @@ S2(const std::vector<size_t>& roi,
    const T& g,
    const M& fmask,
    const M& gmask,
-   bool periodic)
+   bool periodic,
+   compute_mode mode)
 {
     Ensemble ensemble(roi, periodic);
-    ensemble.S2(f, g, fmask, gmask);
+    ensemble.S2(f, g, fmask, gmask, mode);
     return ensemble.result();
 }
 
 template <class T>
-inline auto C2(const std::vector<size_t>& roi, const T& f, const T& g, bool periodic)
+inline array_type::array<double> S2_matrix(
+    const std::vector<size_t>& roi,
+    const T& labels,
+    size_t nphases,
+    bool periodic,
+    compute_mode mode)
+{
+    using value_type = typename T::value_type;
+
+    static_assert(std::is_integral<value_type>::value, "Integral image required.");
+
+    GOOSEEYE_ASSERT(labels.dimension() == roi.size(), std::out_of_range);
+    GOOSEEYE_ASSERT(roi.size() <= 3, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::greater_equal(labels, 0)), std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::less(labels, static_cast<value_type>(nphases))), std::out_of_range);
+    GOOSEEYE_REQUIRE(mode == compute_mode::direct || mode == compute_mode::fft, std::out_of_range);
+
+    // region-of-interest (quasi-3d)
+    auto r = xt::atleast_3d(xt::zeros<double>(roi));
+    std::vector<size_t> shape(r.shape().cbegin(), r.shape().cend());
+    std::vector<std::vector<size_t>> pad = detail::pad_width(shape);
+    size_t size = r.size();
+
+    // not periodic (default): padded items are of no phase (skipped)
+    xt::pad_mode pad_mode = xt::pad_mode::constant;
+
+    // periodic: padded items are periodic copies
+    if (periodic) {
+        pad_mode = xt::pad_mode::periodic;
+    }
+
+    // anchors, and padded comparison image
+    array_type::tensor<size_t, 3> F = xt::atleast_3d(labels);
+    array_type::tensor<size_t, 3> G = xt::pad(F, pad, pad_mode, nphases);
+
+    // counts [nphases, nphases, roi]
+    std::vector<size_t> ret_shape = {nphases, nphases};
+    ret_shape.insert(ret_shape.end(), roi.cbegin(), roi.cend());
+    array_type::array<double> ret = xt::zeros<double>(ret_shape);
+
+    if (mode == compute_mode::direct) {
+        detail::stencil::Geometry geo = detail::stencil::geometry(F.shape(), shape);
+        detail::stencil::S2_matrix(geo, 0, geo.chunks(), F.data(), G.data(), nphases, ret.data());
+    }
+    else {
+        // one transform per phase of the anchors and per phase of the comparison image
+        std::array<size_t, 3> fft_shape = detail::fft::padded_shape(F.shape(), pad);
+        std::array<size_t, 3> zero = {0, 0, 0};
+        std::array<size_t, 3> offset = {pad[0][0], pad[1][0], pad[2][0]};
+        detail::fft::Plan3 plan = detail::fft::plan(fft_shape);
+        std::vector<std::vector<detail::fft::complex>> A;
+        std::vector<std::vector<detail::fft::complex>> B;
+
+        for (size_t a = 0; a < nphases; ++a) {
+            auto Fa = xt::equal(F, a);
+            auto Ga = xt::equal(G, a);
+            A.push_back(detail::fft::spectrum(detail::fft::embed(Fa, zero, fft_shape), plan));
+            B.push_back(detail::fft::spectrum(detail::fft::embed(Ga, offset, fft_shape), plan));
+        }
+
+        for (size_t a = 0; a < nphases; ++a) {
+            for (size_t b = 0; b < nphases; ++b) {
+                double* out = ret.data() + (a * nphases + b) * size;
+                std::vector<double> c = detail::fft::correlate(A[a], B[b], plan);
+                detail::fft::add_lags(c, fft_shape, pad, out, true);
+            }
+        }
+    }
+
+    // normalisation: the number of pairs is the sum over all pairs of phases
+    std::vector<double> norm(size, 0.0);
+    for (size_t ab = 0; ab < nphases * nphases; ++ab) {
+        for (size_t i = 0; i < size; ++i) {
+            norm[i] += ret.flat(ab * size + i);
+        }
+    }
+
+    for (size_t ab = 0; ab < nphases * nphases; ++ab) {
+        for (size_t i = 0; i < size; ++i) {
+            if (norm[i] > 0) {
+                ret.flat(ab * size + i) /= norm[i];
+            }
+        }
+    }
+
+    return ret;
+}
+
+template <class T>
+inline auto
+C2(const std::vector<size_t>& roi, const T& f, const T& g, bool periodic, compute_mode mode)
 {
     Ensemble ensemble(roi, periodic);
-    ensemble.C2(f, g);
+    ensemble.C2(f, g, mode);
     return ensemble.result();
 }
 
@@ -86,27 +186,38 @@ C2(const std::vector<size_t>& roi,
    const T& g,
    const M& fmask,
    const M& gmask,
-   bool periodic)
+   bool periodic,
+   compute_mode mode)
 {
     Ensemble ensemble(roi, periodic);
-    ensemble.C2(f, g, fmask, gmask);
+    ensemble.C2(f, g, fmask, gmask, mode);
     return ensemble.result();
 }
 
 template <class T>
-inline auto W2(const std::vector<size_t>& roi, const T& w, const T& f, bool periodic)
+inline auto W2(
+    const std::vector<size_t>& roi,
+    const T& w,
+    const T& f,
+    bool periodic,
+    compute_mode mode)
 {
     Ensemble ensemble(roi, periodic);
-    ensemble.W2(w, f);
+    ensemble.W2(w, f, mode);
     return ensemble.result();
 }
 
 template <class T, class M>
 inline auto
-W2(const std::vector<size_t>& roi, const T& w, const T& f, const M& fmask, bool periodic)
+W2(const std::vector<size_t>& roi,
+   const T& w,
+   const T& f,
+   const M& fmask,
+   bool periodic,
+   compute_mode mode)
 {
     Ensemble ensemble(roi, periodic);
-    ensemble.W2(w, f, fmask);
+    ensemble.W2(w, f, fmask, mode);
     return ensemble.result();
 }
 
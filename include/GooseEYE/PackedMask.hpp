@@ -0,0 +1,72 @@
+/**
+ * @file
+ * @copyright Copyright 2017. Tom de Geus. All rights reserved.
+ * @license This project is released under the GPLv3 License.
+ */
+
+#ifndef GOOSEEYE_PACKEDMASK_HPP
+#define GOOSEEYE_PACKEDMASK_HPP
+
+#include "GooseEYE.h"
+
+namespace GooseEYE {
+
+template <class T>
+inline PackedMask::PackedMask(const T& mask)
+{
+    GOOSEEYE_ASSERT(mask.dimension() >= 1 && mask.dimension() <= 3, std::out_of_range);
+    GOOSEEYE_ASSERT(xt::all(xt::equal(mask, 0) || xt::equal(mask, 1)), std::out_of_range);
+
+    m_shape = std::vector<size_t>(mask.shape().cbegin(), mask.shape().cend());
+    m_shift = detail::binary::shift(detail::shape_3d(m_shape));
+    m_shape_3d = detail::binary::roll(detail::shape_3d(m_shape), m_shift);
+
+    // pack along the last axis with extent
+    auto M = xt::atleast_3d(mask);
+    auto value = [&](size_t h, size_t i, size_t j) -> bool { return M(h, i, j) != 0; };
+    m_data = detail::binary::pack(m_shape_3d, detail::binary::unroll(m_shift, value));
+}
+
+inline const std::vector<size_t>& PackedMask::shape() const
+{
+    return m_shape;
+}
+
+inline bool PackedMask::any() const
+{
+    return std::any_of(m_data.cbegin(), m_data.cend(), [](uint64_t w) { return w != 0; });
+}
+
+inline bool PackedMask::operator()(size_t h, size_t i, size_t j) const
+{
+    // index in the shape in which the mask is packed
+    std::array<size_t, 6> index = {0, 0, 0, h, i, j};
+    size_t k = 3 - m_shift;
+    return detail::binary::bit(m_data, m_shape_3d, index[k], index[k + 1], index[k + 2]);
+}
+
+inline array_type::array<int> PackedMask::unpack() const
+{
+    array_type::array<int> ret = xt::empty<int>(m_shape);
+    size_t k = 0;
+
+    // rolling the shape does not change the layout in memory
+    for (size_t h = 0; h < m_shape_3d[0]; ++h) {
+        for (size_t i = 0; i < m_shape_3d[1]; ++i) {
+            for (size_t j = 0; j < m_shape_3d[2]; ++j) {
+                ret.flat(k++) = detail::binary::bit(m_data, m_shape_3d, h, i, j);
+            }
+        }
+    }
+
+    return ret;
+}
+
+inline const std::vector<uint64_t>& PackedMask::data() const
+{
+    return m_data;
+}
+
+} // namespace GooseEYE
+
+#endif
@@ -16,9 +16,13 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <assert.h>
+#include <complex>
+#include <cstdint>
 #include <cstdlib>
 #include <exception>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -27,6 +31,7 @@
 #include <memory>
 #include <numeric>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
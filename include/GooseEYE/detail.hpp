@@ -125,6 +125,350 @@ inline std::vector<std::vector<size_t>> pad_width(const T& a)
     return pad_width(shape);
 }
 
+/*
+Coarsen an image (3d) by averaging blocks of two pixels along each axis, skipping masked pixels.
+The block at the end of an axis of odd shape has one pixel along that axis
+(an axis of shape one keeps shape one).
+
+@arg f : Image (3d), replaced by the coarse image.
+@arg mask : Mask of the image (1: masked, 0: not masked) (3d), replaced by the mask of the
+    coarse image (1: all pixels of the block are masked, 0: otherwise).
+*/
+template <class T, class M>
+inline void coarsen(T& f, M& mask)
+{
+    std::array<size_t, 3> shape;
+
+    for (size_t d = 0; d < 3; ++d) {
+        shape[d] = (f.shape(d) + 1) / 2;
+    }
+
+    T g = xt::zeros<typename T::value_type>(shape);
+    M gmask = xt::zeros<typename M::value_type>(shape);
+    std::vector<size_t> n(g.size(), 0);
+
+    for (size_t h = 0; h < f.shape(0); ++h) {
+        for (size_t i = 0; i < f.shape(1); ++i) {
+            for (size_t j = 0; j < f.shape(2); ++j) {
+                if (mask(h, i, j)) {
+                    continue;
+                }
+                size_t b = ((h / 2) * shape[1] + i / 2) * shape[2] + j / 2;
+                g.flat(b) += f(h, i, j);
+                n[b]++;
+            }
+        }
+    }
+
+    for (size_t b = 0; b < g.size(); ++b) {
+        if (n[b] == 0) {
+            gmask.flat(b) = 1;
+        }
+        else {
+            g.flat(b) /= static_cast<typename T::value_type>(n[b]);
+        }
+    }
+
+    f = std::move(g);
+    mask = std::move(gmask);
+}
+
+/*
+Shape of an image, converted to quasi-3d as "xt::atleast_3d".
+
+@arg shape : Shape of the image.
+@ret Shape (3d).
+*/
+template <class S>
+inline std::array<size_t, 3> shape_3d(const S& shape)
+{
+    std::array<size_t, 3> ret = {1, 1, 1};
+
+    if (shape.size() == 1) {
+        ret[1] = shape[0];
+        return ret;
+    }
+
+    for (size_t d = 0; d < shape.size(); ++d) {
+        ret[d] = shape[d];
+    }
+
+    return ret;
+}
+
+/*
+Shape of one sample of a stack of images (stacked along the first axis),
+converted to quasi-3d as "xt::atleast_3d".
+
+@arg shape : Shape of the stack.
+@ret Shape of one sample (3d).
+*/
+template <class S>
+inline std::array<size_t, 3> sample_shape(const S& shape)
+{
+    std::array<size_t, 3> ret = {1, 1, 1};
+    size_t n = shape.size() - 1;
+
+    if (n == 1) {
+        ret[1] = shape[1];
+        return ret;
+    }
+
+    for (size_t d = 0; d < n; ++d) {
+        ret[d] = shape[d + 1];
+    }
+
+    return ret;
+}
+
+/*
+Number of chunks in which to split each row of anchors (along the last axis), such that there
+are at least as many chunks as threads (e.g. for a 1d image, that has only one row).
+
+@arg rows : Number of rows.
+@arg n : Number of anchors per row.
+@arg parts : Number of threads.
+@ret Number of chunks per row.
+*/
+inline size_t split(size_t rows, size_t n, size_t parts)
+{
+    if (rows >= parts || rows == 0) {
+        return 1;
+    }
+
+    return std::max<size_t>(1, std::min(n, (parts + rows - 1) / rows));
+}
+
+/*
+Check if an array exposes its memory ("data()" and "data_offset()"), as containers and views do.
+*/
+template <class T, class = void>
+struct has_memory : std::false_type {
+};
+
+template <class T>
+struct has_memory<
+    T,
+    std::void_t<
+        decltype(std::declval<const T&>().data()),
+        decltype(std::declval<const T&>().data_offset())>> : std::true_type {
+};
+
+/*
+Read-only access to the items of an array in row-major order, through a pointer.
+An array that is contiguous in row-major order is read in-place (at "data() + data_offset()"),
+any other array (a strided view, a column-major array, or an expression) is first copied.
+*/
+template <class T>
+class RowMajor {
+public:
+    using value_type = typename T::value_type;
+
+    /*
+    @arg a : Array (kept alive by the caller, if it is read in-place).
+    */
+    explicit RowMajor(const T& a)
+    {
+        if constexpr (has_memory<T>::value) {
+            if (a.layout() == xt::layout_type::row_major) {
+                m_data = a.data() + a.data_offset();
+                return;
+            }
+        }
+
+        m_copy = a;
+        m_data = m_copy.data();
+    }
+
+    /*
+    @ret Pointer to the first item.
+    */
+    const value_type* data() const
+    {
+        return m_data;
+    }
+
+private:
+    xt::xarray<value_type, xt::layout_type::row_major> m_copy;
+    const value_type* m_data = nullptr;
+};
+
+/*
+Pad a (3d) array as "xt::pad", but write to an existing array (such that its memory can be reused).
+Padded items are periodic copies, or equal to a constant value.
+
+@arg in : Array (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg periodic : Pad periodically if true, with "value" otherwise.
+@arg value : Value of the padded items (not periodic).
+@arg out : Padded array (3d), of shape "in.shape(d) + pad[d][0] + pad[d][1]" (modified in-place).
+*/
+template <class E, class P, class V, class R>
+inline void pad_into(const E& in, const P& pad, bool periodic, V value, R& out)
+{
+    // per axis: index in "in" of each item of "out" ("-1" for a padded item with "value")
+    std::array<std::vector<ptrdiff_t>, 3> index;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ptrdiff_t n = static_cast<ptrdiff_t>(in.shape(d));
+        index[d].resize(out.shape(d));
+        for (size_t p = 0; p < out.shape(d); ++p) {
+            ptrdiff_t q = static_cast<ptrdiff_t>(p) - static_cast<ptrdiff_t>(pad[d][0]);
+            if (q >= 0 && q < n) {
+                index[d][p] = q;
+            }
+            else if (periodic) {
+                index[d][p] = ((q % n) + n) % n;
+            }
+            else {
+                index[d][p] = -1;
+            }
+        }
+    }
+
+    for (size_t h = 0; h < out.shape(0); ++h) {
+        for (size_t i = 0; i < out.shape(1); ++i) {
+            for (size_t j = 0; j < out.shape(2); ++j) {
+                if (index[0][h] < 0 || index[1][i] < 0 || index[2][j] < 0) {
+                    out(h, i, j) = value;
+                }
+                else {
+                    out(h, i, j) = in(index[0][h], index[1][i], index[2][j]);
+                }
+            }
+        }
+    }
+}
+
+/*
+Outputs of the kernels, besides "double*" (one sum per lag of the region-of-interest).
+All have the interface of a pointer to the lags: "(out + o)[c] += value" adds to the lag with
+flat index "o + c", and "if (out)" checks that the output is used (a "nullptr" is skipped).
+*/
+namespace output {
+
+/*
+Sum per bin of lags (e.g. of the distance, see "Ensemble::set_radial"), that are accumulated
+directly: a table gives the bin of each lag.
+*/
+struct Bins {
+    double* data = nullptr; // sum per bin
+    const size_t* bin = nullptr; // per lag: bin
+
+    Bins operator+(size_t offset) const
+    {
+        return {data, bin + offset};
+    }
+
+    double& operator[](size_t c) const
+    {
+        return data[bin[c]];
+    }
+
+    explicit operator bool() const
+    {
+        return data != nullptr;
+    }
+};
+
+/*
+Integer count per lag (see "Ensemble::set_accumulator").
+Adding a value throws if it is not a non-negative integer, or if the count overflows.
+*/
+struct Counts {
+    uint64_t* data = nullptr; // count per lag
+
+    struct Item {
+        uint64_t& count;
+
+        void operator+=(double value) const
+        {
+            GOOSEEYE_REQUIRE(value >= 0 && value == std::floor(value), std::out_of_range);
+            GOOSEEYE_REQUIRE(value < std::ldexp(1.0, 64), std::out_of_range);
+            uint64_t n = static_cast<uint64_t>(value);
+            GOOSEEYE_REQUIRE(n <= std::numeric_limits<uint64_t>::max() - count, std::out_of_range);
+            count += n;
+        }
+    };
+
+    Counts operator+(size_t offset) const
+    {
+        return {data + offset};
+    }
+
+    Item operator[](size_t c) const
+    {
+        return {data[c]};
+    }
+
+    explicit operator bool() const
+    {
+        return data != nullptr;
+    }
+};
+
+} // namespace output
+
+/*
+Add the normalisation of a 2-point correlation of an image without masks (padded as the direct
+loop): the number of anchors "x" for which "x + dx" is part of the image (not periodic),
+or the number of anchors (periodic).
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg periodic : Periodicity of the image.
+@arg norm : Normalisation [roi] (flat index, see "output"; modified in-place).
+*/
+template <class S, class P, class O>
+inline void add_overlap(const S& shape, const P& pad, bool periodic, O norm)
+{
+    // per axis: the number of anchors per lag
+    std::array<std::vector<double>, 3> overlap;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ptrdiff_t n = static_cast<ptrdiff_t>(shape[d]);
+        overlap[d].resize(pad[d][0] + pad[d][1] + 1);
+        for (size_t i = 0; i < overlap[d].size(); ++i) {
+            ptrdiff_t lag = static_cast<ptrdiff_t>(i) - static_cast<ptrdiff_t>(pad[d][0]);
+            ptrdiff_t m = periodic ? n : std::max<ptrdiff_t>(n - std::abs(lag), 0);
+            overlap[d][i] = static_cast<double>(m);
+        }
+    }
+
+    size_t k = 0;
+
+    for (size_t h = 0; h < overlap[0].size(); ++h) {
+        for (size_t i = 0; i < overlap[1].size(); ++i) {
+            for (size_t j = 0; j < overlap[2].size(); ++j) {
+                norm[k++] += overlap[0][h] * overlap[1][i] * overlap[2][j];
+            }
+        }
+    }
+}
+
+/*
+Add the normalisation of a 2-point correlation of an image without masks for a list of lags,
+as "add_overlap" for a region-of-interest.
+
+@arg shape : Shape of the image (3d).
+@arg lags : Lags (3d) [n, 3].
+@arg periodic : Periodicity of the image.
+@arg norm : Normalisation [n] (modified in-place).
+*/
+template <class S, class L, class R>
+inline void add_overlap_lags(const S& shape, const L& lags, bool periodic, R& norm)
+{
+    for (size_t k = 0; k < lags.shape(0); ++k) {
+        double m = 1.0;
+        for (size_t d = 0; d < 3; ++d) {
+            ptrdiff_t n = static_cast<ptrdiff_t>(shape[d]);
+            ptrdiff_t lag = static_cast<ptrdiff_t>(lags(k, d));
+            m *= static_cast<double>(periodic ? n : std::max<ptrdiff_t>(n - std::abs(lag), 0));
+        }
+        norm(k) += m;
+    }
+}
+
 /*
 Compute pixel-path using the Bresenham-algorithm.
 See: https://www.geeksforgeeks.org/bresenhams-algorithm-for-3-d-line-drawing/
@@ -407,6 +751,2423 @@ inline array_type::tensor<int, 2> full(const T& xa, const T& xb)
 }
 } // namespace path
 
+/*
+Discrete Fourier transforms (self-contained, no external dependency).
+*/
+namespace fft {
+
+using complex = std::complex<double>;
+
+/*
+Smallest power of two that is not smaller than "n".
+
+@arg n : Length.
+@ret Power of two.
+*/
+inline size_t next_pow2(size_t n)
+{
+    size_t m = 1;
+    while (m < n) {
+        m <<= 1;
+    }
+    return m;
+}
+
+/*
+Pre-computed data to compute the discrete Fourier transform of a fixed length.
+Powers of two use an iterative radix-2 algorithm, all other lengths are mapped on a
+radix-2 convolution using Bluestein's algorithm.
+The plan is read-only once constructed, scratch-memory is supplied by the caller.
+*/
+class Plan {
+public:
+    Plan() = default;
+
+    /*
+    @arg n : Length of the transform.
+    */
+    explicit Plan(size_t n) : m_n(n)
+    {
+        m_m = next_pow2(n);
+
+        if (m_m != n) {
+            m_m = next_pow2(2 * n - 1);
+        }
+
+        this->init_radix2();
+
+        if (m_m == n) {
+            return;
+        }
+
+        // Bluestein: chirp "w(k) = exp(-i pi k^2 / n)", and the transform of its conjugate
+        m_chirp.resize(n);
+        for (size_t k = 0; k < n; ++k) {
+            size_t k2 = (k * k) % (2 * n);
+            double phi = M_PI * static_cast<double>(k2) / static_cast<double>(n);
+            m_chirp[k] = complex(std::cos(phi), -std::sin(phi));
+        }
+
+        m_filter.assign(m_m, complex(0.0, 0.0));
+        m_filter[0] = std::conj(m_chirp[0]);
+        for (size_t k = 1; k < n; ++k) {
+            m_filter[k] = std::conj(m_chirp[k]);
+            m_filter[m_m - k] = std::conj(m_chirp[k]);
+        }
+        this->radix2(m_filter.data(), false);
+    }
+
+    /*
+    @ret Length of the transform.
+    */
+    size_t size() const
+    {
+        return m_n;
+    }
+
+    /*
+    @ret Size of the scratch-memory needed by "forward" and "backward" (may be zero).
+    */
+    size_t work_size() const
+    {
+        return m_chirp.size() > 0 ? m_m : 0;
+    }
+
+    /*
+    Forward transform (in-place): "A(k) = sum_j a(j) exp(-2 pi i j k / n)".
+
+    @arg a : Contiguous data [size()].
+    @arg work : Scratch-memory [work_size()].
+    */
+    void forward(complex* a, complex* work) const
+    {
+        if (m_chirp.size() == 0) {
+            this->radix2(a, false);
+            return;
+        }
+
+        std::fill(work, work + m_m, complex(0.0, 0.0));
+        for (size_t k = 0; k < m_n; ++k) {
+            work[k] = a[k] * m_chirp[k];
+        }
+        this->radix2(work, false);
+        for (size_t k = 0; k < m_m; ++k) {
+            work[k] *= m_filter[k];
+        }
+        this->radix2(work, true);
+        double scale = 1.0 / static_cast<double>(m_m);
+        for (size_t k = 0; k < m_n; ++k) {
+            a[k] = work[k] * m_chirp[k] * scale;
+        }
+    }
+
+    /*
+    Backward transform (in-place), not normalised: "backward(forward(a)) = n * a".
+
+    @arg a : Contiguous data [size()].
+    @arg work : Scratch-memory [work_size()].
+    */
+    void backward(complex* a, complex* work) const
+    {
+        for (size_t k = 0; k < m_n; ++k) {
+            a[k] = std::conj(a[k]);
+        }
+        this->forward(a, work);
+        for (size_t k = 0; k < m_n; ++k) {
+            a[k] = std::conj(a[k]);
+        }
+    }
+
+private:
+    void init_radix2()
+    {
+        size_t bits = 0;
+        while ((size_t(1) << bits) < m_m) {
+            ++bits;
+        }
+
+        m_rev.resize(m_m);
+        for (size_t i = 0; i < m_m; ++i) {
+            size_t r = 0;
+            for (size_t b = 0; b < bits; ++b) {
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            m_rev[i] = r;
+        }
+
+        m_twiddle.resize(m_m / 2);
+        for (size_t k = 0; k < m_m / 2; ++k) {
+            double phi = 2.0 * M_PI * static_cast<double>(k) / static_cast<double>(m_m);
+            m_twiddle[k] = complex(std::cos(phi), -std::sin(phi));
+        }
+    }
+
+    void radix2(complex* a, bool inverse) const
+    {
+        for (size_t i = 0; i < m_m; ++i) {
+            if (i < m_rev[i]) {
+                std::swap(a[i], a[m_rev[i]]);
+            }
+        }
+
+        for (size_t len = 2; len <= m_m; len <<= 1) {
+            size_t half = len / 2;
+            size_t step = m_m / len;
+            for (size_t i = 0; i < m_m; i += len) {
+                for (size_t j = 0; j < half; ++j) {
+                    complex w = inverse ? std::conj(m_twiddle[j * step]) : m_twiddle[j * step];
+                    complex u = a[i + j];
+                    complex v = a[i + j + half] * w;
+                    a[i + j] = u + v;
+                    a[i + j + half] = u - v;
+                }
+            }
+        }
+    }
+
+    size_t m_n = 0; // length of the transform
+    size_t m_m = 0; // length of the radix-2 transform
+    std::vector<size_t> m_rev; // bit-reversal permutation [m_m]
+    std::vector<complex> m_twiddle; // exp(-2 pi i k / m_m) [m_m / 2]
+    std::vector<complex> m_chirp; // Bluestein chirp [m_n] (empty for powers of two)
+    std::vector<complex> m_filter; // transform of the conjugate chirp [m_m]
+};
+
+/*
+Plans along each axis of a 3-d array.
+*/
+using Plan3 = std::array<Plan, 3>;
+
+/*
+Get plans for a 3-d array.
+
+@arg shape : Shape of the array.
+@ret Plan along each axis.
+*/
+template <class S>
+inline Plan3 plan(const S& shape)
+{
+    return Plan3{Plan(shape[0]), Plan(shape[1]), Plan(shape[2])};
+}
+
+/*
+Transform (in-place) of a row-major 3-d array along all axes.
+
+@arg data : Data [plan[0].size() * plan[1].size() * plan[2].size()].
+@arg plan : Plans along each axis.
+@arg inverse : Compute the (not normalised) backward transform.
+*/
+inline void transform(std::vector<complex>& data, const Plan3& plan, bool inverse)
+{
+    std::array<size_t, 3> n = {plan[0].size(), plan[1].size(), plan[2].size()};
+    std::array<size_t, 3> stride = {n[1] * n[2], n[2], 1};
+    size_t nmax = std::max({n[0], n[1], n[2]});
+    size_t wmax = std::max({plan[0].work_size(), plan[1].work_size(), plan[2].work_size()});
+    std::vector<complex> line(nmax);
+    std::vector<complex> work(wmax);
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+
+        if (n[axis] == 1) {
+            continue;
+        }
+
+        // loop over all lines along "axis": "stride[axis] * n[axis]" is the size of one block
+        size_t block = stride[axis] * n[axis];
+
+        for (size_t b = 0; b < data.size(); b += block) {
+            for (size_t o = 0; o < stride[axis]; ++o) {
+                complex* a = &data[b + o];
+                for (size_t k = 0; k < n[axis]; ++k) {
+                    line[k] = a[k * stride[axis]];
+                }
+                if (inverse) {
+                    plan[axis].backward(line.data(), work.data());
+                }
+                else {
+                    plan[axis].forward(line.data(), work.data());
+                }
+                for (size_t k = 0; k < n[axis]; ++k) {
+                    a[k * stride[axis]] = line[k];
+                }
+            }
+        }
+    }
+}
+
+/*
+Periodic cross-correlation of two real, row-major, 3-d arrays:
+"c(s) = sum_x a(x) b(x + s)" with "x + s" wrapped with the shape of the plans.
+Both arrays are transformed at once by packing them as "a + i b".
+
+@arg a : Array [plan[0].size() * plan[1].size() * plan[2].size()].
+@arg b : Array [plan[0].size() * plan[1].size() * plan[2].size()].
+@arg plan : Plans along each axis.
+@ret The correlation (same shape as the input).
+*/
+inline std::vector<double> correlate(const double* a, const double* b, const Plan3& plan)
+{
+    std::array<size_t, 3> n = {plan[0].size(), plan[1].size(), plan[2].size()};
+    size_t size = n[0] * n[1] * n[2];
+
+    std::vector<complex> z(size);
+    for (size_t i = 0; i < size; ++i) {
+        z[i] = complex(a[i], b[i]);
+    }
+
+    transform(z, plan, false);
+
+    // unpack "A(k) = (Z(k) + conj(Z(-k))) / 2" and "B(k) = (Z(k) - conj(Z(-k))) / (2 i)",
+    // and form "C(k) = conj(A(k)) * B(k)"
+    std::vector<complex> c(size);
+    for (size_t h = 0; h < n[0]; ++h) {
+        size_t mh = (n[0] - h) % n[0];
+        for (size_t i = 0; i < n[1]; ++i) {
+            size_t mi = (n[1] - i) % n[1];
+            for (size_t j = 0; j < n[2]; ++j) {
+                size_t mj = (n[2] - j) % n[2];
+                complex zk = z[(h * n[1] + i) * n[2] + j];
+                complex zm = std::conj(z[(mh * n[1] + mi) * n[2] + mj]);
+                complex ak = 0.5 * (zk + zm);
+                complex bk = complex(0.0, -0.5) * (zk - zm);
+                c[(h * n[1] + i) * n[2] + j] = std::conj(ak) * bk;
+            }
+        }
+    }
+
+    transform(c, plan, true);
+
+    std::vector<double> ret(size);
+    double scale = 1.0 / static_cast<double>(size);
+    for (size_t i = 0; i < size; ++i) {
+        ret[i] = c[i].real() * scale;
+    }
+
+    return ret;
+}
+
+/*
+Transform of a real array (to reuse the transform for several correlations).
+
+@arg a : Array [plan[0].size() * plan[1].size() * plan[2].size()].
+@arg plan : Plans along each axis.
+@ret The transform.
+*/
+inline std::vector<complex> spectrum(const std::vector<double>& a, const Plan3& plan)
+{
+    std::vector<complex> ret(a.cbegin(), a.cend());
+    transform(ret, plan, false);
+    return ret;
+}
+
+/*
+Periodic cross-correlation "c(s) = sum_x a(x) b(x + s)", from the transforms of "a" and "b".
+
+@arg a : Transform of "a", see "spectrum".
+@arg b : Transform of "b", see "spectrum".
+@arg plan : Plans along each axis.
+@ret The correlation (same shape as the input).
+*/
+inline std::vector<double>
+correlate(const std::vector<complex>& a, const std::vector<complex>& b, const Plan3& plan)
+{
+    std::vector<complex> c(a.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        c[i] = std::conj(a[i]) * b[i];
+    }
+
+    transform(c, plan, true);
+
+    std::vector<double> ret(c.size());
+    double scale = 1.0 / static_cast<double>(c.size());
+    for (size_t i = 0; i < c.size(); ++i) {
+        ret[i] = c[i].real() * scale;
+    }
+
+    return ret;
+}
+
+/*
+Add the lags "-pad[d][0] <= r_d <= pad[d][1]" of a periodic correlation to a
+region-of-interest (whose shape is "pad[d][0] + pad[d][1] + 1" along each axis).
+
+@arg c : Correlation, see "correlate".
+@arg shape : Shape of "c".
+@arg pad : Pad-width (3d), see "pad_width".
+@arg ret : Region-of-interest to which the result is added (flat index, see "output").
+@arg round : Round to the nearest integer (for correlations of integers).
+*/
+template <class S, class P, class O>
+inline void add_lags(const std::vector<double>& c, const S& shape, const P& pad, O ret, bool round)
+{
+    std::array<std::vector<size_t>, 3> idx;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ptrdiff_t n = static_cast<ptrdiff_t>(shape[d]);
+        ptrdiff_t lo = -static_cast<ptrdiff_t>(pad[d][0]);
+        ptrdiff_t hi = static_cast<ptrdiff_t>(pad[d][1]);
+        for (ptrdiff_t r = lo; r <= hi; ++r) {
+            idx[d].push_back(static_cast<size_t>(((r % n) + n) % n));
+        }
+    }
+
+    size_t k = 0;
+
+    for (size_t h = 0; h < idx[0].size(); ++h) {
+        for (size_t i = 0; i < idx[1].size(); ++i) {
+            for (size_t j = 0; j < idx[2].size(); ++j) {
+                double v = c[(idx[0][h] * shape[1] + idx[1][i]) * shape[2] + idx[2][j]];
+                if (round) {
+                    v = std::round(v);
+                }
+                ret[k++] += v;
+            }
+        }
+    }
+}
+
+/*
+Shape of a periodic array that can hold an image padded with "pad" without overlap,
+rounded up to a length for which the transform is fast.
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@ret Shape.
+*/
+template <class S, class P>
+inline std::array<size_t, 3> padded_shape(const S& shape, const P& pad)
+{
+    std::array<size_t, 3> ret;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ret[d] = next_pow2(shape[d] + pad[d][0] + pad[d][1]);
+    }
+
+    return ret;
+}
+
+/*
+Estimate if "n" correlations by transforms (see "add_correlation") are faster than the direct
+loop over all pixels and lags. One correlation takes three transforms of "padded_shape", of about
+"5 P log2(P)" floating-point operations for "P" items, while the direct loop takes a few
+operations per pixel and lag.
+
+@arg n : Number of correlations (e.g. the number of labels plus one for the normalisation).
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@ret True if the transforms are expected to be faster.
+*/
+template <class S, class P>
+inline bool faster(size_t n, const S& shape, const P& pad)
+{
+    std::array<size_t, 3> padded = padded_shape(shape, pad);
+    double items = 1.0;
+    double direct = 1.0;
+
+    for (size_t d = 0; d < 3; ++d) {
+        items *= static_cast<double>(padded[d]);
+        direct *= static_cast<double>(shape[d] * (pad[d][0] + pad[d][1] + 1));
+    }
+
+    return 15.0 * static_cast<double>(n) * items * std::log2(items) < 2.0 * direct;
+}
+
+/*
+Copy a 3-d array into a (larger) periodic array, such that item "offset[d]" ends up at index 0,
+and items before it wrap around to the end.
+
+@arg a : Array.
+@arg offset : Offset along each axis (e.g. the pad-width "pad[d][0]").
+@arg shape : Shape of the periodic array.
+@ret The periodic array (row-major, zero where "a" is not copied).
+*/
+template <class T, class O>
+inline std::vector<double>
+embed(const T& a, const O& offset, const std::array<size_t, 3>& shape)
+{
+    std::vector<double> ret(shape[0] * shape[1] * shape[2], 0.0);
+
+    for (size_t h = 0; h < a.shape(0); ++h) {
+        size_t hh = (h + shape[0] - offset[0]) % shape[0];
+        for (size_t i = 0; i < a.shape(1); ++i) {
+            size_t ii = (i + shape[1] - offset[1]) % shape[1];
+            for (size_t j = 0; j < a.shape(2); ++j) {
+                size_t jj = (j + shape[2] - offset[2]) % shape[2];
+                ret[(hh * shape[1] + ii) * shape[2] + jj] = static_cast<double>(a(h, i, j));
+            }
+        }
+    }
+
+    return ret;
+}
+
+/*
+Add the cross-correlation "c(r) = sum_x a(x) b(x + r)" to a region-of-interest,
+for lags "-pad[d][0] <= r_d <= pad[d][1]".
+Thereby "a" is an image and "b" is an image padded with "pad": the padded items are used
+as they are (they can follow from periodicity, or be masked).
+The correlation is computed in a zero-padded periodic array such that no lag wraps.
+
+@arg a : Image (3d).
+@arg b : Padded image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg plan : Plans for the transform, of shape "padded_shape(a.shape(), pad)".
+@arg ret : Region-of-interest to which the result is added (flat index, see "output").
+@arg round : Round to the nearest integer (for correlations of integers).
+*/
+template <class T, class U, class P, class O>
+inline void
+add_correlation(const T& a, const U& b, const P& pad, const Plan3& plan, O ret, bool round)
+{
+    std::array<size_t, 3> shape = {plan[0].size(), plan[1].size(), plan[2].size()};
+    std::array<size_t, 3> zero = {0, 0, 0};
+    std::array<size_t, 3> offset = {pad[0][0], pad[1][0], pad[2][0]};
+    std::vector<double> ap = embed(a, zero, shape);
+    std::vector<double> bp = embed(b, offset, shape);
+    std::vector<double> c = correlate(ap.data(), bp.data(), plan);
+    add_lags(c, shape, pad, ret, round);
+}
+
+} // namespace fft
+
+/*
+Images of zeros and ones, stored as bits (packed row-by-row along the last axis).
+*/
+namespace binary {
+
+using word = uint64_t;
+
+/*
+Number of words needed to store a row.
+
+@arg n : Number of bits.
+@ret Number of words.
+*/
+inline size_t nwords(size_t n)
+{
+    return (n + 63) / 64;
+}
+
+/*
+Number of set bits.
+
+@arg x : Word.
+@ret Number of ones.
+*/
+inline uint64_t popcount(word x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint64_t>(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+/*
+Number of trailing axes along which both an image and a region-of-interest have shape one
+(e.g. of 1d and 2d images, see "xt::atleast_3d").
+Moving them to the front (see "roll") does not change the layout in memory, but makes that the
+rows of bits run along the last axis with extent (instead of rows of one bit per word).
+
+@arg shape : Shape of the image (3d).
+@arg roi : Shape of the region-of-interest (3d).
+@ret Number of axes.
+*/
+template <class S, class R>
+inline size_t shift(const S& shape, const R& roi)
+{
+    size_t ret = 0;
+
+    while (ret < 2 && shape[2 - ret] == 1 && roi[2 - ret] == 1) {
+        ++ret;
+    }
+
+    return ret;
+}
+
+/*
+Number of trailing axes of shape one of an image, see "shift(shape, roi)".
+
+@arg shape : Shape of the image (3d).
+@ret Number of axes.
+*/
+template <class S>
+inline size_t shift(const S& shape)
+{
+    return shift(shape, std::array<size_t, 3>{1, 1, 1});
+}
+
+/*
+Move the last axes of a shape to the front.
+
+@arg shape : Shape (3d).
+@arg n : Number of axes (of shape one), see "shift".
+@ret Shape (3d).
+*/
+template <class S>
+inline std::array<size_t, 3> roll(const S& shape, size_t n)
+{
+    std::array<size_t, 3> ret;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ret[d] = d < n ? 1 : shape[d - n];
+    }
+
+    return ret;
+}
+
+/*
+Wrap a function of an index such that it can be called with the index in the rolled shape.
+
+@arg n : Number of axes, see "roll".
+@arg func : Function "func(h, i, j)" of the index in the original shape.
+@ret Function "func(h, i, j)" of the index in the rolled shape.
+*/
+template <class F>
+inline auto unroll(size_t n, F func)
+{
+    return [n, func](size_t h, size_t i, size_t j) {
+        std::array<size_t, 6> index = {h, i, j, 0, 0, 0};
+        return func(index[n], index[n + 1], index[n + 2]);
+    };
+}
+
+/*
+Pack a 3-d image row-by-row.
+The image is specified by a function such that it can be read from a (virtually) padded image
+without copying.
+
+@arg shape : Shape of the image.
+@arg value : Function "bool value(h, i, j)" that returns the value of a pixel.
+@ret Words [shape[0] * shape[1] * nwords(shape[2]) + 1], the last word is zero.
+*/
+template <class S, class F>
+inline std::vector<word> pack(const S& shape, F value)
+{
+    size_t nw = nwords(shape[2]);
+    std::vector<word> ret(shape[0] * shape[1] * nw + 1, 0);
+
+    for (size_t h = 0; h < shape[0]; ++h) {
+        for (size_t i = 0; i < shape[1]; ++i) {
+            word* row = &ret[(h * shape[1] + i) * nw];
+            for (size_t j = 0; j < shape[2]; ++j) {
+                if (value(h, i, j)) {
+                    row[j >> 6] |= word(1) << (j & 63);
+                }
+            }
+        }
+    }
+
+    return ret;
+}
+
+/*
+Read one bit of a packed image.
+
+@arg a : Packed image, see "pack".
+@arg shape : Shape of the image.
+@arg h : Index along the first axis.
+@arg i : Index along the second axis.
+@arg j : Index along the last axis.
+@ret Value of the pixel.
+*/
+template <class S>
+inline bool bit(const std::vector<word>& a, const S& shape, size_t h, size_t i, size_t j)
+{
+    return (a[(h * shape[1] + i) * nwords(shape[2]) + (j >> 6)] >> (j & 63)) & word(1);
+}
+
+/*
+Pack the inverse of a mask (1: not masked, 0: masked), padded as the direct loop:
+padded items are not masked if periodic, and masked if not periodic.
+
+@arg shape : Shape of the mask (3d).
+@arg pad : Pad-width, see "pad_width".
+@arg periodic : Periodicity of the image.
+@arg n : Number of trailing axes that are moved to the front before packing, see "shift".
+@arg masked : Function "bool masked(h, i, j)" that returns the value of the mask.
+@ret Packed inverse of the padded mask in the rolled shape (see "roll"), see "pack".
+*/
+template <class S, class P, class M>
+inline std::vector<word>
+pack_inverse(const S& shape, const P& pad, bool periodic, size_t n, M masked)
+{
+    std::array<size_t, 3> padded;
+    for (size_t d = 0; d < 3; ++d) {
+        padded[d] = shape[d] + pad[d][0] + pad[d][1];
+    }
+
+    // check if an item of the padded mask is a padded item
+    auto outside = [&](size_t d, size_t p) -> bool {
+        return p < pad[d][0] || p >= pad[d][0] + shape[d];
+    };
+
+    // inverse of the padded mask
+    auto value = [&](size_t h, size_t i, size_t j) -> bool {
+        if (outside(0, h) || outside(1, i) || outside(2, j)) {
+            return periodic;
+        }
+        return !masked(h - pad[0][0], i - pad[1][0], j - pad[2][0]);
+    };
+
+    return pack(roll(padded, n), unroll(n, value));
+}
+
+/*
+Set the items of an image for which the bit of a packed image is not set to zero.
+
+@arg a : Packed image, see "pack".
+@arg shape : Shape of the image.
+@arg data : Image [shape] (modified in-place).
+*/
+template <class S, class T>
+inline void apply(const std::vector<word>& a, const S& shape, T* data)
+{
+    for (size_t h = 0; h < shape[0]; ++h) {
+        for (size_t i = 0; i < shape[1]; ++i) {
+            for (size_t j = 0; j < shape[2]; ++j) {
+                if (!bit(a, shape, h, i, j)) {
+                    data[(h * shape[1] + i) * shape[2] + j] = T(0);
+                }
+            }
+        }
+    }
+}
+
+/*
+Read 64 bits from a packed row, starting at an arbitrary bit.
+Bits beyond the end of the row are read from the next row (the caller has to mask them).
+
+@arg row : Packed row.
+@arg offset : Index of the first bit.
+@ret Word.
+*/
+inline word read(const word* row, size_t offset)
+{
+    size_t w = offset >> 6;
+    size_t s = offset & 63;
+
+    if (s == 0) {
+        return row[w];
+    }
+
+    return (row[w] >> s) | (row[w + 1] << (64 - s));
+}
+
+/*
+Count co-occurrences for all lags in a region-of-interest:
+"ret(a, b, c) += sum_x A(x) * B(x + (a, b, c))"
+with "A" an image and "B" an image padded such that its shape is "shape + roi - 1".
+
+@arg a : Packed image, see "pack".
+@arg b : Packed padded image, see "pack".
+@arg shape : Shape of the image "A".
+@arg roi : Shape of the region-of-interest.
+@arg ret : Counts [roi[0] * roi[1] * roi[2]] (flat index, see "output"; modified in-place).
+*/
+template <class S, class R, class O>
+inline void correlate(
+    const std::vector<word>& a,
+    const std::vector<word>& b,
+    const S& shape,
+    const R& roi,
+    O ret)
+{
+    std::array<size_t, 3> p;
+    for (size_t d = 0; d < 3; ++d) {
+        p[d] = shape[d] + roi[d] - 1;
+    }
+
+    size_t na = nwords(shape[2]);
+    size_t nb = nwords(p[2]);
+
+    // skip empty rows of the image
+    std::vector<size_t> rows;
+    for (size_t k = 0; k < shape[0] * shape[1]; ++k) {
+        for (size_t w = 0; w < na; ++w) {
+            if (a[k * na + w]) {
+                rows.push_back(k);
+                break;
+            }
+        }
+    }
+
+    for (size_t h = 0; h < roi[0]; ++h) {
+        for (size_t i = 0; i < roi[1]; ++i) {
+            O out = ret + (h * roi[1] + i) * roi[2];
+            for (auto& k : rows) {
+                size_t kh = k / shape[1];
+                size_t ki = k % shape[1];
+                const word* arow = &a[k * na];
+                const word* brow = &b[((kh + h) * p[1] + ki + i) * nb];
+                for (size_t j = 0; j < roi[2]; ++j) {
+                    uint64_t n = 0;
+                    for (size_t w = 0; w < na; ++w) {
+                        n += popcount(arow[w] & read(brow, j + 64 * w));
+                    }
+                    out[j] += n;
+                }
+            }
+        }
+    }
+}
+
+} // namespace binary
+
+/*
+Direct kernels: loop over all anchors (pixels) of an image, and add the region-of-interest
+around each anchor.
+All arrays are row-major and 3-d.
+The comparison arrays are padded (see "pad_width"), such that the region-of-interest around the
+anchor "(h, i, j)" of the image starts at the item "(h, i, j)" of the padded array.
+The region-of-interest is walked row-by-row using pre-computed flat offsets,
+such that the innermost loop is contiguous.
+The comparison arrays can be of any type (e.g. the type of the image, and "uint8_t" for the
+inverse of the mask): they are only converted to double when accumulating.
+The results are added to a "double*" or to one of the outputs in "output" (e.g. per bin).
+*/
+namespace stencil {
+
+/*
+Geometry of the loop.
+The lags are stored as runs of lags that are contiguous along the last axis
+(by default: one run per row of the region-of-interest).
+*/
+struct Geometry {
+    std::array<size_t, 3> shape; // shape of the image (the anchors)
+    std::array<size_t, 3> padded; // shape of the padded image
+    size_t size; // number of lags in the region-of-interest
+    std::vector<size_t> lag; // per run of lags: offset in the padded image
+    std::vector<size_t> out; // per run of lags: offset in the output
+    std::vector<size_t> width; // per run of lags: number of lags
+    std::vector<std::array<ptrdiff_t, 3>> dx; // per run of lags: first lag
+    std::array<size_t, 2> tile = {0, 0}; // per tile: anchors along the last axis, runs (0: all)
+    size_t split = 1; // number of chunks per row of anchors (along the last axis)
+
+    /*
+    @ret Number of chunks of anchors: the rows of anchors (along the last axis), each split in
+        "split" chunks. The chunks are the items that are distributed over the threads.
+    */
+    size_t chunks() const
+    {
+        return shape[0] * shape[1] * split;
+    }
+
+    /*
+    @arg r : Row of anchors.
+    @ret Offset of the region-of-interest of the first anchor of the row in the padded image.
+    */
+    size_t origin(size_t r) const
+    {
+        return ((r / shape[1]) * padded[1] + r % shape[1]) * padded[2];
+    }
+};
+
+/*
+Check if the value of an auto-correlation at a lag "r" follows from the value at "-r"
+(as "S(r) = S(-r)"). This is the case if "r < 0" (lexicographically) and if "-r" is part of
+the region-of-interest (not the case for the last item along an axis of even length).
+
+@arg index : Index of the lag in the region-of-interest (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@ret true if the value follows from "-r".
+*/
+template <class I, class P>
+inline bool mirrored(const I& index, const P& pad)
+{
+    for (size_t d = 0; d < 3; ++d) {
+        if (index[d] > 2 * pad[d][0]) {
+            return false;
+        }
+    }
+
+    for (size_t d = 0; d < 3; ++d) {
+        if (index[d] != pad[d][0]) {
+            return index[d] < pad[d][0];
+        }
+    }
+
+    return false;
+}
+
+/*
+Fill the lags of an auto-correlation that follow from "S(r) = S(-r)", see "mirrored".
+
+@arg a : Region-of-interest (3d), modified in-place.
+@arg pad : Pad-width (3d), see "pad_width".
+*/
+template <class T, class P>
+inline void mirror(T& a, const P& pad)
+{
+    for (size_t h = 0; h < a.shape(0); ++h) {
+        for (size_t i = 0; i < a.shape(1); ++i) {
+            for (size_t j = 0; j < a.shape(2); ++j) {
+                std::array<size_t, 3> index = {h, i, j};
+                if (mirrored(index, pad)) {
+                    a(h, i, j) = a(2 * pad[0][0] - h, 2 * pad[1][0] - i, 2 * pad[2][0] - j);
+                }
+            }
+        }
+    }
+}
+
+/*
+Get the geometry of the loop.
+Trailing axes along which both the image and the region-of-interest have shape one
+(e.g. of 1d and 2d images, see "xt::atleast_3d") are moved to the front. This does not change
+the layout in memory, but makes that the loops run along the last axis with extent
+(instead of over rows of one anchor, with runs of one lag).
+If there are fewer rows of anchors than threads, the rows are split along the last axis.
+
+@arg shape : Shape of the image (3d).
+@arg roi : Shape of the region-of-interest (3d).
+@arg symmetric : Skip the lags that follow from "S(r) = S(-r)", see "mirrored".
+@arg threads : Number of threads, see "Geometry::chunks".
+@ret Geometry.
+*/
+template <class S, class R>
+inline Geometry geometry(const S& shape, const R& roi, bool symmetric = false, size_t threads = 1)
+{
+    std::vector<std::vector<size_t>> pad = pad_width(std::vector<size_t>(roi.begin(), roi.end()));
+
+    Geometry ret;
+    ret.size = roi[0] * roi[1] * roi[2];
+
+    // number of trailing axes of shape one that are moved to the front
+    size_t shift = 0;
+    while (shift < 2 && shape[2 - shift] == 1 && roi[2 - shift] == 1) {
+        ++shift;
+    }
+
+    std::array<size_t, 3> r;
+    std::array<ptrdiff_t, 3> left;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ret.shape[d] = d < shift ? 1 : shape[d - shift];
+        r[d] = d < shift ? 1 : roi[d - shift];
+        left[d] = d < shift ? 0 : static_cast<ptrdiff_t>(pad[d - shift][0]);
+        ret.padded[d] = ret.shape[d] + r[d] - 1;
+    }
+
+    auto skip = [&](size_t h, size_t i, size_t j) -> bool {
+        std::array<size_t, 3> c = {h, i, j};
+        std::array<size_t, 3> index = {0, 0, 0};
+        for (size_t d = shift; d < 3; ++d) {
+            index[d - shift] = c[d];
+        }
+        return symmetric && mirrored(index, pad);
+    };
+
+    for (size_t h = 0; h < r[0]; ++h) {
+        for (size_t i = 0; i < r[1]; ++i) {
+            size_t j = 0;
+            while (j < r[2]) {
+                if (skip(h, i, j)) {
+                    ++j;
+                    continue;
+                }
+                size_t first = j;
+                while (j < r[2] && !skip(h, i, j)) {
+                    ++j;
+                }
+                ret.lag.push_back((h * ret.padded[1] + i) * ret.padded[2] + first);
+                ret.out.push_back((h * r[1] + i) * r[2] + first);
+                ret.width.push_back(j - first);
+                ret.dx.push_back(
+                    {static_cast<ptrdiff_t>(h) - left[0],
+                     static_cast<ptrdiff_t>(i) - left[1],
+                     static_cast<ptrdiff_t>(first) - left[2]});
+            }
+        }
+    }
+
+    ret.split = detail::split(ret.shape[0] * ret.shape[1], ret.shape[2], threads);
+
+    return ret;
+}
+
+/*
+Pad-width such that the comparison of each anchor for each lag in a list is part of the padded
+image (as "pad_width" for a region-of-interest).
+
+@arg lags : Lags (3d) [n, 3].
+@ret Pad-width (3d): the largest negative and positive lag along each axis.
+*/
+template <class L>
+inline std::vector<std::vector<size_t>> pad_width_lags(const L& lags)
+{
+    std::vector<std::vector<size_t>> ret(3, std::vector<size_t>(2, 0));
+
+    for (size_t k = 0; k < lags.shape(0); ++k) {
+        for (size_t d = 0; d < 3; ++d) {
+            ptrdiff_t l = lags(k, d);
+            if (l < 0) {
+                ret[d][0] = std::max(ret[d][0], static_cast<size_t>(-l));
+            }
+            else {
+                ret[d][1] = std::max(ret[d][1], static_cast<size_t>(l));
+            }
+        }
+    }
+
+    return ret;
+}
+
+/*
+Get the geometry of the loop for a list of lags (instead of a region-of-interest).
+Consecutive lags in the list that are adjacent along the last axis are stored as one run.
+Trailing axes along which the image has shape one and all lags are zero are moved to the front,
+and rows of anchors are split over the threads, as in "geometry".
+
+@arg shape : Shape of the image (3d).
+@arg lags : Lags (3d) [n, 3].
+@arg pad : Pad-width (3d), see "pad_width_lags".
+@arg threads : Number of threads, see "Geometry::chunks".
+@ret Geometry (the output is indexed by the index of the lag in the list).
+*/
+template <class S, class L, class P>
+inline Geometry geometry_lags(const S& shape, const L& lags, const P& pad, size_t threads = 1)
+{
+    Geometry ret;
+    ret.size = lags.shape(0);
+
+    // number of trailing axes of shape one that are moved to the front
+    size_t shift = 0;
+    while (shift < 2 && shape[2 - shift] == 1 && pad[2 - shift][0] == 0 &&
+           pad[2 - shift][1] == 0) {
+        ++shift;
+    }
+
+    std::array<size_t, 3> left;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ret.shape[d] = d < shift ? 1 : shape[d - shift];
+        left[d] = d < shift ? 0 : pad[d - shift][0];
+        ret.padded[d] = d < shift ? 1 : shape[d - shift] + pad[d - shift][0] + pad[d - shift][1];
+    }
+
+    auto lag = [&](size_t k, size_t d) -> ptrdiff_t {
+        return d < shift ? 0 : static_cast<ptrdiff_t>(lags(k, d - shift));
+    };
+
+    for (size_t k = 0; k < lags.shape(0); ++k) {
+        if (k > 0 && lag(k, 0) == lag(k - 1, 0) && lag(k, 1) == lag(k - 1, 1) &&
+            lag(k, 2) == lag(k - 1, 2) + 1) {
+            ret.width.back()++;
+            continue;
+        }
+        std::array<size_t, 3> index;
+        for (size_t d = 0; d < 3; ++d) {
+            index[d] = static_cast<size_t>(lag(k, d) + static_cast<ptrdiff_t>(left[d]));
+        }
+        ret.lag.push_back((index[0] * ret.padded[1] + index[1]) * ret.padded[2] + index[2]);
+        ret.out.push_back(k);
+        ret.width.push_back(1);
+        ret.dx.push_back({lag(k, 0), lag(k, 1), lag(k, 2)});
+    }
+
+    ret.split = detail::split(ret.shape[0] * ret.shape[1], ret.shape[2], threads);
+
+    return ret;
+}
+
+/*
+Choose the tiles of the loop (see "tiles"), such that the part of the padded comparison image,
+its mask, and the output (three moments) that are used by one tile fit in a cache
+(assuming items of type "double").
+A tile contains a few times the width of the region-of-interest of anchors along the last axis,
+such that most of the comparison image that is read by one anchor is reused by the next anchors.
+
+@arg geo : Geometry.
+@arg bytes : Size of the cache (default: 256 kB, the L2 cache of one core of many machines).
+@ret Number of anchors along the last axis, and number of runs of lags, per tile.
+*/
+inline std::array<size_t, 2> auto_tiles(const Geometry& geo, size_t bytes = 262144)
+{
+    size_t w = 1;
+
+    for (size_t k = 0; k < geo.width.size(); ++k) {
+        w = std::max(w, geo.width[k]);
+    }
+
+    size_t anchors = std::min(geo.shape[2], std::max<size_t>(64, 4 * w));
+    size_t items = 2 * (anchors + w) + 3 * w;
+    size_t runs = std::max<size_t>(1, bytes / (sizeof(double) * items));
+
+    return {anchors, std::min(runs, geo.lag.size())};
+}
+
+/*
+Loop over the chunks of anchors in tiles, that each cover a block of anchors along the last axis
+and a block of runs of lags (see "Geometry::tile"). Per lag, the anchors are visited in the
+same order as without tiles, such that the result does not depend on the tiles.
+
+@arg geo : Geometry.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg func : Kernel of one tile: "func(r, j0, j1, k0, k1)" for row of anchors "r",
+    anchors "[j0, j1)" along the last axis, and runs of lags "[k0, k1)".
+*/
+template <class F>
+inline void tiles(const Geometry& geo, size_t begin, size_t end, F func)
+{
+    size_t n = geo.lag.size();
+    size_t nj = geo.shape[2];
+    size_t tj = geo.tile[0] > 0 ? geo.tile[0] : nj;
+    size_t tk = geo.tile[1] > 0 ? geo.tile[1] : n;
+
+    for (size_t c = begin; c < end; ++c) {
+        size_t r = c / geo.split;
+        size_t ja = (nj * (c % geo.split)) / geo.split;
+        size_t jb = (nj * (c % geo.split + 1)) / geo.split;
+        for (size_t j0 = ja; j0 < jb; j0 += tj) {
+            for (size_t k0 = 0; k0 < n; k0 += tk) {
+                func(r, j0, std::min(j0 + tj, jb), k0, std::min(k0 + tk, n));
+            }
+        }
+    }
+}
+
+/*
+2-point correlation, for all non-masked anchors "x":
+"first(dx) += f(x) * g(x + dx)" and "norm(dx) += gmii(x + dx)".
+
+@arg geo : Geometry.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [geo.shape].
+@arg fmask : Mask of the image (1: masked, 0: not masked) [geo.shape].
+@arg g : Padded comparison image, multiplied by "gmii" [geo.padded].
+@arg gmii : Inverse of the padded comparison mask (1: not masked, 0: masked) [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class T, class M, class U, class V, class O>
+inline void S2(
+    const Geometry& geo,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const M* fmask,
+    const U* g,
+    const V* gmii,
+    O first,
+    O norm)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* fr = f + r * geo.shape[2];
+        const M* mr = fmask + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        for (size_t j = j0; j < j1; ++j) {
+            if (mr[j]) {
+                continue;
+            }
+            double fj = static_cast<double>(fr[j]);
+            for (size_t k = k0; k < k1; ++k) {
+                size_t w = geo.width[k];
+                const U* gk = g + origin + j + geo.lag[k];
+                const V* mk = gmii + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                O nk = norm + geo.out[k];
+                if (fr[j] != 0) {
+                    for (size_t c = 0; c < w; ++c) {
+                        ok[c] += fj * static_cast<double>(gk[c]);
+                    }
+                }
+                for (size_t c = 0; c < w; ++c) {
+                    nk[c] += static_cast<double>(mk[c]);
+                }
+            }
+        }
+    });
+}
+
+/*
+2-point cluster function, for all non-masked anchors "x":
+"first(dx) += (f(x) == g(x + dx)) * gmii(x + dx)" and "norm(dx) += gmii(x + dx)".
+
+@arg geo : Geometry.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [geo.shape].
+@arg fmask : Mask of the image (1: masked, 0: not masked) [geo.shape].
+@arg g : Padded comparison image [geo.padded].
+@arg gmii : Inverse of the padded comparison mask (1: not masked, 0: masked) [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class T, class M, class V, class O>
+inline void C2(
+    const Geometry& geo,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const M* fmask,
+    const T* g,
+    const V* gmii,
+    O first,
+    O norm)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* fr = f + r * geo.shape[2];
+        const M* mr = fmask + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        for (size_t j = j0; j < j1; ++j) {
+            if (mr[j]) {
+                continue;
+            }
+            T fj = fr[j];
+            for (size_t k = k0; k < k1; ++k) {
+                size_t w = geo.width[k];
+                const T* gk = g + origin + j + geo.lag[k];
+                const V* mk = gmii + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                O nk = norm + geo.out[k];
+                if (fj != 0) {
+                    for (size_t c = 0; c < w; ++c) {
+                        ok[c] += gk[c] == fj ? static_cast<double>(mk[c]) : 0.0;
+                    }
+                }
+                for (size_t c = 0; c < w; ++c) {
+                    nk[c] += static_cast<double>(mk[c]);
+                }
+            }
+        }
+    });
+}
+
+/*
+Weighted 2-point correlation, for all anchors "x":
+"first(dx) += w(x) * g(x + dx)" and "norm(dx) += w(x) * gmii(x + dx)".
+
+@arg geo : Geometry.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg w : Weights [geo.shape].
+@arg g : Padded comparison image, multiplied by "gmii" [geo.padded].
+@arg gmii : Inverse of the padded comparison mask (1: not masked, 0: masked) [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class T, class U, class V, class O>
+inline void W2(
+    const Geometry& geo,
+    size_t begin,
+    size_t end,
+    const T* w,
+    const U* g,
+    const V* gmii,
+    O first,
+    O norm)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* wr = w + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        for (size_t j = j0; j < j1; ++j) {
+            if (wr[j] == 0) {
+                continue;
+            }
+            double wj = static_cast<double>(wr[j]);
+            for (size_t k = k0; k < k1; ++k) {
+                size_t width = geo.width[k];
+                const U* gk = g + origin + j + geo.lag[k];
+                const V* mk = gmii + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                O nk = norm + geo.out[k];
+                for (size_t c = 0; c < width; ++c) {
+                    ok[c] += wj * static_cast<double>(gk[c]);
+                    nk[c] += wj * static_cast<double>(mk[c]);
+                }
+            }
+        }
+    });
+}
+
+/*
+Comparisons of a run of lags of an anchor that are part of the image (to loop without a mask).
+
+@arg geo : Geometry.
+@arg periodic : Periodicity of the image (if true: all comparisons are part of the image).
+@arg h : Index of the anchor along the first axis.
+@arg i : Index of the anchor along the second axis.
+@arg j : Index of the anchor along the last axis.
+@arg k : Run of lags.
+@ret Comparisons "[c0, c1)" of the run (empty if "c0 >= c1").
+*/
+inline std::array<size_t, 2>
+inside(const Geometry& geo, bool periodic, size_t h, size_t i, size_t j, size_t k)
+{
+    if (periodic) {
+        return {0, geo.width[k]};
+    }
+
+    const std::array<ptrdiff_t, 3>& dx = geo.dx[k];
+    ptrdiff_t a = static_cast<ptrdiff_t>(h) + dx[0];
+    ptrdiff_t b = static_cast<ptrdiff_t>(i) + dx[1];
+    ptrdiff_t c = static_cast<ptrdiff_t>(j) + dx[2];
+
+    if (a < 0 || a >= static_cast<ptrdiff_t>(geo.shape[0]) || b < 0 ||
+        b >= static_cast<ptrdiff_t>(geo.shape[1])) {
+        return {0, 0};
+    }
+
+    ptrdiff_t c0 = std::max<ptrdiff_t>(0, -c);
+    ptrdiff_t c1 = std::min(
+        static_cast<ptrdiff_t>(geo.width[k]), static_cast<ptrdiff_t>(geo.shape[2]) - c);
+
+    if (c1 <= c0) {
+        return {0, 0};
+    }
+
+    return {static_cast<size_t>(c0), static_cast<size_t>(c1)};
+}
+
+/*
+2-point correlation of an image without masks, for all anchors "x" and all comparisons
+"x + dx" that are part of the image: "first(dx) += f(x) * g(x + dx)".
+The normalisation follows analytically, see "add_overlap".
+
+@arg geo : Geometry.
+@arg periodic : Periodicity of the image.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [geo.shape].
+@arg g : Padded comparison image [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+*/
+template <class T, class U, class O>
+inline void S2(
+    const Geometry& geo,
+    bool periodic,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const U* g,
+    O first)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* fr = f + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        size_t h = r / geo.shape[1];
+        size_t i = r % geo.shape[1];
+        for (size_t j = j0; j < j1; ++j) {
+            if (fr[j] == 0) {
+                continue;
+            }
+            double fj = static_cast<double>(fr[j]);
+            for (size_t k = k0; k < k1; ++k) {
+                std::array<size_t, 2> c = inside(geo, periodic, h, i, j, k);
+                const U* gk = g + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                for (size_t l = c[0]; l < c[1]; ++l) {
+                    ok[l] += fj * static_cast<double>(gk[l]);
+                }
+            }
+        }
+    });
+}
+
+/*
+2-point cluster function of an image without masks, for all anchors "x" and all comparisons
+"x + dx" that are part of the image: "first(dx) += (f(x) == g(x + dx))" (for "f(x) != 0").
+The normalisation follows analytically, see "add_overlap".
+
+@arg geo : Geometry.
+@arg periodic : Periodicity of the image.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [geo.shape].
+@arg g : Padded comparison image [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+*/
+template <class T, class O>
+inline void C2(
+    const Geometry& geo,
+    bool periodic,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const T* g,
+    O first)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* fr = f + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        size_t h = r / geo.shape[1];
+        size_t i = r % geo.shape[1];
+        for (size_t j = j0; j < j1; ++j) {
+            T fj = fr[j];
+            if (fj == 0) {
+                continue;
+            }
+            for (size_t k = k0; k < k1; ++k) {
+                std::array<size_t, 2> c = inside(geo, periodic, h, i, j, k);
+                const T* gk = g + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                for (size_t l = c[0]; l < c[1]; ++l) {
+                    ok[l] += gk[l] == fj ? 1.0 : 0.0;
+                }
+            }
+        }
+    });
+}
+
+/*
+Weighted 2-point correlation of an image without masks, for all anchors "x" and all
+comparisons "x + dx" that are part of the image: "first(dx) += w(x) * g(x + dx)" and
+"norm(dx) += w(x)".
+
+@arg geo : Geometry.
+@arg periodic : Periodicity of the image.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg w : Weights [geo.shape].
+@arg g : Padded comparison image [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class T, class U, class O>
+inline void W2(
+    const Geometry& geo,
+    bool periodic,
+    size_t begin,
+    size_t end,
+    const T* w,
+    const U* g,
+    O first,
+    O norm)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* wr = w + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        size_t h = r / geo.shape[1];
+        size_t i = r % geo.shape[1];
+        for (size_t j = j0; j < j1; ++j) {
+            if (wr[j] == 0) {
+                continue;
+            }
+            double wj = static_cast<double>(wr[j]);
+            for (size_t k = k0; k < k1; ++k) {
+                std::array<size_t, 2> c = inside(geo, periodic, h, i, j, k);
+                const U* gk = g + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                O nk = norm + geo.out[k];
+                for (size_t l = c[0]; l < c[1]; ++l) {
+                    ok[l] += wj * static_cast<double>(gk[l]);
+                    nk[l] += wj;
+                }
+            }
+        }
+    });
+}
+
+/*
+Flat index of the non-zero anchors, to loop over a sparse image (see "sparse").
+
+@arg size : Number of anchors.
+@arg f : Image [size].
+@ret Flat index of each non-zero anchor (in increasing order).
+*/
+template <class T>
+inline std::vector<size_t> nonzero(size_t size, const T* f)
+{
+    std::vector<size_t> ret;
+
+    for (size_t x = 0; x < size; ++x) {
+        if (f[x] != 0) {
+            ret.push_back(x);
+        }
+    }
+
+    return ret;
+}
+
+/*
+Weighted 2-point correlation for a list of anchors "x" (see "nonzero"):
+"first(dx) += w(x) * g(x + dx)", and "norm(dx) += w(x) * gmii(x + dx)" (unless "norm" is null).
+Gives the same result as "S2" (with masked anchors set to zero) or "W2" (weights "w"),
+as the other anchors do not contribute (to "first").
+
+@arg geo : Geometry.
+@arg anchors : Flat index of the anchors.
+@arg begin : First anchor (index in "anchors").
+@arg end : Last anchor (not included).
+@arg w : Weights [geo.shape].
+@arg g : Padded comparison image, multiplied by "gmii" [geo.padded].
+@arg gmii : Inverse of the padded comparison mask (1: not masked, 0: masked) [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place), or "nullptr".
+*/
+template <class T, class U, class V, class O>
+inline void sparse(
+    const Geometry& geo,
+    const std::vector<size_t>& anchors,
+    size_t begin,
+    size_t end,
+    const T* w,
+    const U* g,
+    const V* gmii,
+    O first,
+    O norm)
+{
+    size_t n = geo.lag.size();
+
+    for (size_t a = begin; a < end; ++a) {
+        size_t x = anchors[a];
+        size_t origin = geo.origin(x / geo.shape[2]) + x % geo.shape[2];
+        double wx = static_cast<double>(w[x]);
+        for (size_t k = 0; k < n; ++k) {
+            size_t width = geo.width[k];
+            const U* gk = g + origin + geo.lag[k];
+            O ok = first + geo.out[k];
+            for (size_t c = 0; c < width; ++c) {
+                ok[c] += wx * static_cast<double>(gk[c]);
+            }
+            if (!norm) {
+                continue;
+            }
+            const V* mk = gmii + origin + geo.lag[k];
+            O nk = norm + geo.out[k];
+            for (size_t c = 0; c < width; ++c) {
+                nk[c] += wx * static_cast<double>(mk[c]);
+            }
+        }
+    }
+}
+
+/*
+Height-height correlation, for all non-masked anchors "x":
+"first(dx) += (f(x + dx) - f(x))^2 * fmii(x + dx)",
+"second(dx) += (f(x + dx) - f(x))^4 * fmii(x + dx)", and "norm(dx) += fmii(x + dx)".
+
+@arg geo : Geometry.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [geo.shape].
+@arg fmask : Mask of the image (1: masked, 0: not masked) [geo.shape].
+@arg g : Padded image [geo.padded].
+@arg gmii : Inverse of the padded mask (1: not masked, 0: masked) [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg second : Sum of the second moment [roi] (modified in-place), skipped if "nullptr".
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class M, class O>
+inline void heightheight(
+    const Geometry& geo,
+    size_t begin,
+    size_t end,
+    const double* f,
+    const M* fmask,
+    const double* g,
+    const double* gmii,
+    O first,
+    O second,
+    O norm)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const double* fr = f + r * geo.shape[2];
+        const M* mr = fmask + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        for (size_t j = j0; j < j1; ++j) {
+            if (mr[j]) {
+                continue;
+            }
+            double fj = fr[j];
+            for (size_t k = k0; k < k1; ++k) {
+                size_t w = geo.width[k];
+                const double* gk = g + origin + j + geo.lag[k];
+                const double* mk = gmii + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                O nk = norm + geo.out[k];
+                for (size_t c = 0; c < w; ++c) {
+                    double d = gk[c] - fj;
+                    ok[c] += d * d * mk[c];
+                    nk[c] += mk[c];
+                }
+                if (second) {
+                    O sk = second + geo.out[k];
+                    for (size_t c = 0; c < w; ++c) {
+                        double d = gk[c] - fj;
+                        sk[c] += d * d * d * d * mk[c];
+                    }
+                }
+            }
+        }
+    });
+}
+
+/*
+Height-height correlation of an image without mask, for all anchors "x" and all comparisons
+"x + dx" that are part of the image: "first(dx) += (f(x + dx) - f(x))^2" and
+"second(dx) += (f(x + dx) - f(x))^4".
+The normalisation follows analytically, see "add_overlap".
+
+@arg geo : Geometry.
+@arg periodic : Periodicity of the image.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [geo.shape].
+@arg g : Padded image [geo.padded].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg second : Sum of the second moment [roi] (modified in-place), skipped if "nullptr".
+*/
+template <class O>
+inline void heightheight(
+    const Geometry& geo,
+    bool periodic,
+    size_t begin,
+    size_t end,
+    const double* f,
+    const double* g,
+    O first,
+    O second)
+{
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const double* fr = f + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        size_t h = r / geo.shape[1];
+        size_t i = r % geo.shape[1];
+        for (size_t j = j0; j < j1; ++j) {
+            double fj = fr[j];
+            for (size_t k = k0; k < k1; ++k) {
+                std::array<size_t, 2> c = inside(geo, periodic, h, i, j, k);
+                const double* gk = g + origin + j + geo.lag[k];
+                O ok = first + geo.out[k];
+                for (size_t l = c[0]; l < c[1]; ++l) {
+                    double d = gk[l] - fj;
+                    ok[l] += d * d;
+                }
+                if (second) {
+                    O sk = second + geo.out[k];
+                    for (size_t l = c[0]; l < c[1]; ++l) {
+                        double d = gk[l] - fj;
+                        sk[l] += d * d * d * d;
+                    }
+                }
+            }
+        }
+    });
+}
+
+/*
+2-point correlation of all pairs of phases, for all anchors "x":
+"first(f(x), g(x + dx), dx) += 1".
+Items whose phase is not smaller than "nphases" are skipped (e.g. padded items).
+
+@arg geo : Geometry.
+@arg begin : First chunk of anchors (see "Geometry::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Phase of each pixel [geo.shape].
+@arg g : Phase of each pixel of the padded comparison image [geo.padded].
+@arg nphases : Number of phases.
+@arg first : Counts [nphases, nphases, roi] (modified in-place).
+*/
+template <class T>
+inline void S2_matrix(
+    const Geometry& geo,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const T* g,
+    size_t nphases,
+    double* first)
+{
+    size_t size = geo.size;
+
+    tiles(geo, begin, end, [&](size_t r, size_t j0, size_t j1, size_t k0, size_t k1) {
+        const T* fr = f + r * geo.shape[2];
+        size_t origin = geo.origin(r);
+        for (size_t j = j0; j < j1; ++j) {
+            if (fr[j] >= nphases) {
+                continue;
+            }
+            double* oj = first + fr[j] * nphases * size;
+            for (size_t k = k0; k < k1; ++k) {
+                size_t w = geo.width[k];
+                const T* gk = g + origin + j + geo.lag[k];
+                double* ok = oj + geo.out[k];
+                for (size_t c = 0; c < w; ++c) {
+                    if (gk[c] < nphases) {
+                        ok[gk[c] * size + c] += 1.0;
+                    }
+                }
+            }
+        }
+    });
+}
+
+} // namespace stencil
+
+/*
+Kernels for a (small) two-dimensional region-of-interest of which the shape "{Rx, Ry}" is known
+at compile time. The accumulators are stack arrays and the loops over the lags have compile-time
+bounds (such that they can be unrolled). The image is not padded: near the edges the index of the
+comparison is wrapped (periodic) or the lag is skipped (not periodic), as the direct loop.
+*/
+namespace fixed {
+
+/*
+Pad-width along an axis of the region-of-interest (as "pad_width").
+
+@arg R : Shape of the region-of-interest along the axis.
+@ret Pad-width before the anchor.
+*/
+template <size_t R>
+constexpr size_t pad()
+{
+    return R % 2 == 1 ? (R - 1) / 2 : R / 2 - 1;
+}
+
+/*
+2-point correlation, not masked, for all anchors "x": "first(dx) += f(x) * g(x + dx)".
+The contributions are added in the same order as "stencil::S2".
+
+@arg nx : Shape of the image along the first axis.
+@arg ny : Shape of the image along the second axis.
+@arg f : Image [nx, ny].
+@arg g : Comparison image [nx, ny].
+@arg periodic : Periodicity of the image.
+@arg first : Sum of the first moment [Rx, Ry] (modified in-place).
+*/
+template <size_t Rx, size_t Ry, class T>
+inline void S2(
+    size_t nx,
+    size_t ny,
+    const T* f,
+    const T* g,
+    bool periodic,
+    std::array<double, Rx * Ry>& first)
+{
+    constexpr size_t px = pad<Rx>();
+    constexpr size_t py = pad<Ry>();
+    ptrdiff_t n = static_cast<ptrdiff_t>(nx);
+    ptrdiff_t m = static_cast<ptrdiff_t>(ny);
+
+    // anchors for which no lag crosses an edge along the second axis
+    size_t jbegin = std::min(py, ny);
+    size_t jend = std::max(jbegin, ny > Ry - 1 - py ? ny - (Ry - 1 - py) : 0);
+
+    for (size_t i = 0; i < nx; ++i) {
+        const T* fi = f + i * ny;
+        for (size_t a = 0; a < Rx; ++a) {
+            ptrdiff_t ii = static_cast<ptrdiff_t>(i + a) - static_cast<ptrdiff_t>(px);
+            if (ii < 0 || ii >= n) {
+                if (!periodic) {
+                    continue;
+                }
+                ii = ((ii % n) + n) % n;
+            }
+            const T* gi = g + ii * m;
+            double* out = first.data() + a * Ry;
+            for (size_t j = 0; j < ny; ++j) {
+                if (fi[j] == 0) {
+                    continue;
+                }
+                double fj = static_cast<double>(fi[j]);
+                if (j >= jbegin && j < jend) {
+                    const T* gj = gi + j - py;
+                    for (size_t b = 0; b < Ry; ++b) {
+                        out[b] += fj * static_cast<double>(gj[b]);
+                    }
+                    continue;
+                }
+                for (size_t b = 0; b < Ry; ++b) {
+                    ptrdiff_t jj = static_cast<ptrdiff_t>(j + b) - static_cast<ptrdiff_t>(py);
+                    if (jj < 0 || jj >= m) {
+                        if (!periodic) {
+                            continue;
+                        }
+                        jj = ((jj % m) + m) % m;
+                    }
+                    out[b] += fj * static_cast<double>(gi[jj]);
+                }
+            }
+        }
+    }
+}
+
+} // namespace fixed
+
+/*
+Kernels for a random sample of anchors. The image is not padded (such that the cost scales with
+the number of anchors, not with the image): near the edges the index of the comparison is
+wrapped (periodic) or the lag is skipped (not periodic), as the direct loop.
+*/
+namespace sampled {
+
+/*
+Draw an index uniformly in "[0, n)".
+A 64-bit number is composed of two 32-bit draws, such that all indices of large images can be
+drawn. Draws below "2^64 mod n" are rejected, such that each index is equally likely.
+
+@arg n : Number of items.
+@arg rng : Random number generator with "next_uint32()" (e.g. "prrng::pcg32").
+@ret Index.
+*/
+template <class R>
+inline uint64_t index(uint64_t n, R& rng)
+{
+    uint64_t threshold = (0 - n) % n;
+
+    while (true) {
+        uint64_t high = rng.next_uint32();
+        uint64_t low = rng.next_uint32();
+        uint64_t r = (high << 32) | low;
+        if (r >= threshold) {
+            return r % n;
+        }
+    }
+}
+
+/*
+Draw anchors uniformly (with replacement).
+
+@arg size : Number of pixels.
+@arg samples : Number of anchors.
+@arg rng : Random number generator (see "index").
+@ret Flat index of each anchor (in increasing order, to traverse the image in order).
+*/
+template <class R>
+inline std::vector<size_t> anchors(size_t size, size_t samples, R& rng)
+{
+    std::vector<size_t> ret(samples);
+
+    for (size_t a = 0; a < samples; ++a) {
+        ret[a] = static_cast<size_t>(index(size, rng));
+    }
+
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+/*
+Index of the comparison along an axis.
+
+@arg x : Index of the anchor.
+@arg d : Index of the lag in the region-of-interest.
+@arg pad : Pad-width before the anchor.
+@arg n : Shape of the image.
+@arg periodic : Periodicity of the image.
+@arg y : Index of the comparison (modified).
+@ret 0: part of the image, 1: periodic copy, 2: not part of the image (not periodic).
+*/
+inline int comparison(size_t x, size_t d, size_t pad, size_t n, bool periodic, size_t& y)
+{
+    ptrdiff_t i = static_cast<ptrdiff_t>(x + d) - static_cast<ptrdiff_t>(pad);
+    ptrdiff_t m = static_cast<ptrdiff_t>(n);
+
+    if (i >= 0 && i < m) {
+        y = static_cast<size_t>(i);
+        return 0;
+    }
+
+    if (!periodic) {
+        return 2;
+    }
+
+    y = static_cast<size_t>(((i % m) + m) % m);
+    return 1;
+}
+
+/*
+2-point correlation, for a sample of anchors "x" (that may contain an anchor more than once):
+"first(dx) += f(x) * g(x + dx)", "second(dx) += (f(x) * g(x + dx))^2", and "norm(dx) += 1",
+for each comparison "x + dx" that is not masked. As the direct loop, periodic copies are
+not masked.
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg periodic : Periodicity of the image.
+@arg anchors : Flat index of the anchors.
+@arg begin : First anchor (index in "anchors").
+@arg end : Last anchor (not included).
+@arg f : Image [shape].
+@arg fmask : Mask of the image (1: masked, 0: not masked) [shape].
+@arg g : Comparison image [shape].
+@arg gmask : Mask of the comparison image (1: masked, 0: not masked) [shape].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg second : Sum of the second moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class T, class M, class P, class O>
+inline void S2(
+    const std::array<size_t, 3>& shape,
+    const P& pad,
+    bool periodic,
+    const std::vector<size_t>& anchors,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const M* fmask,
+    const T* g,
+    const M* gmask,
+    O first,
+    O second,
+    O norm)
+{
+    std::array<size_t, 3> roi;
+
+    for (size_t d = 0; d < 3; ++d) {
+        roi[d] = pad[d][0] + pad[d][1] + 1;
+    }
+
+    for (size_t a = begin; a < end; ++a) {
+        size_t x = anchors[a];
+        if (fmask[x]) {
+            continue;
+        }
+        std::array<size_t, 3> index = {
+            x / (shape[1] * shape[2]), (x / shape[2]) % shape[1], x % shape[2]};
+        double fx = static_cast<double>(f[x]);
+        std::array<size_t, 3> y;
+        std::array<int, 3> copy;
+        for (size_t h = 0; h < roi[0]; ++h) {
+            copy[0] = comparison(index[0], h, pad[0][0], shape[0], periodic, y[0]);
+            if (copy[0] == 2) {
+                continue;
+            }
+            for (size_t i = 0; i < roi[1]; ++i) {
+                copy[1] = comparison(index[1], i, pad[1][0], shape[1], periodic, y[1]);
+                if (copy[1] == 2) {
+                    continue;
+                }
+                size_t o = (h * roi[1] + i) * roi[2];
+                for (size_t j = 0; j < roi[2]; ++j) {
+                    copy[2] = comparison(index[2], j, pad[2][0], shape[2], periodic, y[2]);
+                    if (copy[2] == 2) {
+                        continue;
+                    }
+                    size_t z = (y[0] * shape[1] + y[1]) * shape[2] + y[2];
+                    if (gmask[z] && copy[0] == 0 && copy[1] == 0 && copy[2] == 0) {
+                        continue;
+                    }
+                    double v = fx * static_cast<double>(g[z]);
+                    first[o + j] += v;
+                    second[o + j] += v * v;
+                    norm[o + j] += 1.0;
+                }
+            }
+        }
+    }
+}
+
+} // namespace sampled
+
+/*
+Direct loops that read the image without padding (or copying) it.
+Per axis, a table gives for each item of the padded image (see "pad_width") the index in the
+image, as "xt::pad": a periodic copy (not masked, as the direct loop), or not part of the image
+(not periodic). The comparisons of anchors for which no lag crosses an edge along the last axis
+are read contiguously; only the boundary shell (along the last axis) uses the table.
+*/
+namespace unpadded {
+
+/*
+Index tables of the padded image, and the chunks of anchors (as "stencil::Geometry::chunks").
+*/
+struct Tables {
+    std::array<std::vector<ptrdiff_t>, 3> index; // per axis: index in the image (-1: not part)
+    std::array<std::vector<uint8_t>, 3> copy; // per axis: 1 if the item is a periodic copy
+    size_t split = 1; // number of chunks per row of anchors (along the last axis)
+    size_t chunks = 0; // number of chunks of anchors (that are distributed over the threads)
+};
+
+/*
+Get the index tables of the padded image.
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg periodic : Periodicity of the image.
+@arg threads : Number of threads (rows of anchors are split if there are fewer rows).
+@ret Tables.
+*/
+template <class S, class P>
+inline Tables tables(const S& shape, const P& pad, bool periodic, size_t threads = 1)
+{
+    Tables ret;
+    ret.split = detail::split(shape[0] * shape[1], shape[2], threads);
+    ret.chunks = shape[0] * shape[1] * ret.split;
+
+    for (size_t d = 0; d < 3; ++d) {
+        ptrdiff_t m = static_cast<ptrdiff_t>(shape[d]);
+        size_t n = shape[d] + pad[d][0] + pad[d][1];
+        ret.index[d].resize(n);
+        ret.copy[d].resize(n);
+        for (size_t p = 0; p < n; ++p) {
+            ptrdiff_t q = static_cast<ptrdiff_t>(p) - static_cast<ptrdiff_t>(pad[d][0]);
+            ret.copy[d][p] = q < 0 || q >= m;
+            if (!ret.copy[d][p]) {
+                ret.index[d][p] = q;
+            }
+            else if (periodic) {
+                ret.index[d][p] = ((q % m) + m) % m;
+            }
+            else {
+                ret.index[d][p] = -1;
+            }
+        }
+    }
+
+    return ret;
+}
+
+/*
+Move trailing axes along which both the image and the region-of-interest have shape one to the
+front, as "stencil::geometry" (this does not change the layout in memory).
+
+@arg shape : Shape of the image (3d) (modified).
+@arg pad : Pad-width (3d), see "pad_width" (modified).
+*/
+inline void squeeze(std::array<size_t, 3>& shape, std::vector<std::vector<size_t>>& pad)
+{
+    while (shape[2] == 1 && pad[2][0] + pad[2][1] == 0 && shape[0] * shape[1] > 1) {
+        shape = {1, shape[0], shape[1]};
+        pad = {{0, 0}, pad[0], pad[1]};
+    }
+}
+
+/*
+Loop over all anchors "x" and lags "dx", in runs of lags that are contiguous along the last
+axis. Per lag, the anchors are visited in the same order as "stencil::tiles".
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg tables : Index tables, see "tables".
+@arg begin : First chunk of anchors (see "Tables::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg func : Kernel of a run: "func(x, o, z, w, copy)" for anchor "x" (flat index),
+    lags "[o, o + w)" (flat index in the region-of-interest), comparisons "[z, z + w)"
+    (flat index in the image), that are periodic copies if "copy".
+*/
+template <class P, class F>
+inline void traverse(
+    const std::array<size_t, 3>& shape,
+    const P& pad,
+    const Tables& tables,
+    size_t begin,
+    size_t end,
+    F func)
+{
+    std::array<size_t, 3> roi;
+
+    for (size_t d = 0; d < 3; ++d) {
+        roi[d] = pad[d][0] + pad[d][1] + 1;
+    }
+
+    // anchors for which no lag crosses an edge along the last axis
+    size_t n = shape[2];
+    size_t jbegin = std::min(pad[2][0], n);
+    size_t jend = std::max(jbegin, n > pad[2][1] ? n - pad[2][1] : 0);
+
+    for (size_t k = begin; k < end; ++k) {
+        size_t r = k / tables.split;
+        size_t ja = (n * (k % tables.split)) / tables.split;
+        size_t jb = (n * (k % tables.split + 1)) / tables.split;
+        size_t h = r / shape[1];
+        size_t i = r % shape[1];
+        for (size_t a = 0; a < roi[0]; ++a) {
+            ptrdiff_t y0 = tables.index[0][h + a];
+            if (y0 < 0) {
+                continue;
+            }
+            for (size_t b = 0; b < roi[1]; ++b) {
+                ptrdiff_t y1 = tables.index[1][i + b];
+                if (y1 < 0) {
+                    continue;
+                }
+                bool copy = tables.copy[0][h + a] || tables.copy[1][i + b];
+                size_t row = (static_cast<size_t>(y0) * shape[1] + static_cast<size_t>(y1)) * n;
+                size_t o = (a * roi[1] + b) * roi[2];
+                for (size_t j = ja; j < jb; ++j) {
+                    if (j >= jbegin && j < jend) {
+                        func(r * n + j, o, row + j - pad[2][0], roi[2], copy);
+                        continue;
+                    }
+                    for (size_t c = 0; c < roi[2]; ++c) {
+                        ptrdiff_t y2 = tables.index[2][j + c];
+                        if (y2 < 0) {
+                            continue;
+                        }
+                        bool cc = copy || tables.copy[2][j + c];
+                        func(r * n + j, o + c, row + static_cast<size_t>(y2), 1, cc);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+2-point correlation, as "stencil::S2" (same arguments, but of the image that is not padded).
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg tables : Index tables, see "tables".
+@arg begin : First chunk of anchors (see "Tables::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [shape].
+@arg fmask : Mask of the image (1: masked, 0: not masked) [shape].
+@arg g : Comparison image [shape].
+@arg gmask : Mask of the comparison image (1: masked, 0: not masked) [shape].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class P, class T, class M, class O>
+inline void S2(
+    const std::array<size_t, 3>& shape,
+    const P& pad,
+    const Tables& tables,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const M* fmask,
+    const T* g,
+    const M* gmask,
+    O first,
+    O norm)
+{
+    traverse(shape, pad, tables, begin, end, [&](size_t x, size_t o, size_t z, size_t w, bool cp) {
+        if (fmask[x]) {
+            return;
+        }
+        double fx = static_cast<double>(f[x]);
+        for (size_t c = 0; c < w; ++c) {
+            if (!cp && gmask[z + c]) {
+                continue;
+            }
+            if (f[x] != 0) {
+                first[o + c] += fx * static_cast<double>(g[z + c]);
+            }
+            norm[o + c] += 1.0;
+        }
+    });
+}
+
+/*
+2-point cluster function, as "stencil::C2" (same arguments, but of the image that is not padded).
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg tables : Index tables, see "tables".
+@arg begin : First chunk of anchors (see "Tables::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg f : Image [shape].
+@arg fmask : Mask of the image (1: masked, 0: not masked) [shape].
+@arg g : Comparison image [shape].
+@arg gmask : Mask of the comparison image (1: masked, 0: not masked) [shape].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class P, class T, class M, class O>
+inline void C2(
+    const std::array<size_t, 3>& shape,
+    const P& pad,
+    const Tables& tables,
+    size_t begin,
+    size_t end,
+    const T* f,
+    const M* fmask,
+    const T* g,
+    const M* gmask,
+    O first,
+    O norm)
+{
+    traverse(shape, pad, tables, begin, end, [&](size_t x, size_t o, size_t z, size_t w, bool cp) {
+        if (fmask[x]) {
+            return;
+        }
+        T fx = f[x];
+        for (size_t c = 0; c < w; ++c) {
+            if (!cp && gmask[z + c]) {
+                continue;
+            }
+            if (fx != 0) {
+                first[o + c] += g[z + c] == fx ? 1.0 : 0.0;
+            }
+            norm[o + c] += 1.0;
+        }
+    });
+}
+
+/*
+Weighted 2-point correlation, as "stencil::W2" (same arguments, but of the image that is not
+padded).
+
+@arg shape : Shape of the image (3d).
+@arg pad : Pad-width (3d), see "pad_width".
+@arg tables : Index tables, see "tables".
+@arg begin : First chunk of anchors (see "Tables::chunks").
+@arg end : Last chunk of anchors (not included).
+@arg w : Weights [shape].
+@arg g : Comparison image [shape].
+@arg gmask : Mask of the comparison image (1: masked, 0: not masked) [shape].
+@arg first : Sum of the first moment [roi] (modified in-place).
+@arg norm : Normalisation [roi] (modified in-place).
+*/
+template <class P, class T, class M, class O>
+inline void W2(
+    const std::array<size_t, 3>& shape,
+    const P& pad,
+    const Tables& tables,
+    size_t begin,
+    size_t end,
+    const T* w,
+    const T* g,
+    const M* gmask,
+    O first,
+    O norm)
+{
+    traverse(shape, pad, tables, begin, end, [&](size_t x, size_t o, size_t z, size_t n, bool cp) {
+        if (w[x] == 0) {
+            return;
+        }
+        double wx = static_cast<double>(w[x]);
+        for (size_t c = 0; c < n; ++c) {
+            if (!cp && gmask[z + c]) {
+                continue;
+            }
+            first[o + c] += wx * static_cast<double>(g[z + c]);
+            norm[o + c] += wx;
+        }
+    });
+}
+
+} // namespace unpadded
+
+/*
+Accumulate in parallel.
+*/
+namespace thread {
+
+/*
+Split items in contiguous chunks of (nearly) equal size.
+
+@arg n : Number of items.
+@arg parts : Number of chunks.
+@ret Boundaries of the chunks [parts + 1].
+*/
+inline std::vector<size_t> partition(size_t n, size_t parts)
+{
+    std::vector<size_t> ret(parts + 1);
+
+    for (size_t i = 0; i <= parts; ++i) {
+        ret[i] = (n * i) / parts;
+    }
+
+    return ret;
+}
+
+/*
+Run "kernel(begin, end, buffers)" on contiguous chunks of the items "[0, n)" in parallel.
+Each thread accumulates in private (zero-initialised) buffers.
+These are added to the output in the order of the chunks,
+such that the result is reproducible for a fixed number of threads.
+The first chunk is run on the calling thread, the others on "nthreads - 1" threads that are
+started and joined in each call.
+If one thread is used, the kernel directly accumulates in the output.
+The buffers are of type "B": "double", or an unsigned integer (throws if the sum overflows).
+
+@arg nthreads : Number of threads.
+@arg n : Number of items (e.g. rows of anchors).
+@arg size : Size of each buffer.
+@arg ret : Output buffers [size] ("nullptr" entries are passed as such to the kernel).
+@arg kernel : Function "void kernel(size_t begin, size_t end, const std::vector<B*>& buffers)".
+*/
+template <class B = double, class K>
+inline void
+accumulate(size_t nthreads, size_t n, size_t size, const std::vector<B*>& ret, K kernel)
+{
+    nthreads = std::max(static_cast<size_t>(1), std::min(nthreads, n));
+
+    if (nthreads == 1) {
+        kernel(0, n, ret);
+        return;
+    }
+
+    std::vector<size_t> chunk = partition(n, nthreads);
+    std::vector<std::vector<B>> mem(nthreads * ret.size());
+    std::vector<std::vector<B*>> buffers(nthreads, std::vector<B*>(ret.size(), nullptr));
+    std::vector<std::exception_ptr> error(nthreads);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < nthreads; ++t) {
+        for (size_t b = 0; b < ret.size(); ++b) {
+            if (ret[b]) {
+                mem[t * ret.size() + b].assign(size, B(0));
+                buffers[t][b] = mem[t * ret.size() + b].data();
+            }
+        }
+    }
+
+    auto run = [&](size_t t) {
+        try {
+            kernel(chunk[t], chunk[t + 1], buffers[t]);
+        }
+        catch (...) {
+            error[t] = std::current_exception();
+        }
+    };
+
+    for (size_t t = 1; t < nthreads; ++t) {
+        threads.emplace_back(run, t);
+    }
+
+    run(0);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (auto& e : error) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+
+    // reduce in a fixed order
+    for (size_t t = 0; t < nthreads; ++t) {
+        for (size_t b = 0; b < ret.size(); ++b) {
+            if (ret[b]) {
+                const B* src = buffers[t][b];
+                B* dest = ret[b];
+                for (size_t i = 0; i < size; ++i) {
+                    if (!std::is_floating_point<B>::value) {
+                        GOOSEEYE_REQUIRE(
+                            src[i] <= std::numeric_limits<B>::max() - dest[i], std::out_of_range);
+                    }
+                    dest[i] += src[i];
+                }
+            }
+        }
+    }
+}
+
+} // namespace thread
+
+/*
+Binary serialisation of plain values and arrays (in the byte order of the machine).
+Reading throws if the stream ends.
+*/
+namespace io {
+
+/*
+Marker of the byte order: it reads back as written only on a machine with the same byte order.
+*/
+constexpr uint32_t byte_order = 0x01020304;
+
+/*
+Stable code of a value in a file: its index in a fixed list of values.
+Values may be appended to the list, but never reordered or removed.
+
+@arg codes : List of values.
+@arg value : Value.
+@ret Code.
+*/
+template <class T, size_t N>
+inline uint8_t encode(const std::array<T, N>& codes, T value)
+{
+    static_assert(N <= 256, "Too many codes.");
+    size_t i = static_cast<size_t>(std::find(codes.cbegin(), codes.cend(), value) - codes.cbegin());
+    GOOSEEYE_REQUIRE(i < N, std::runtime_error);
+    return static_cast<uint8_t>(i);
+}
+
+/*
+Value of a code written by "encode".
+
+@arg codes : List of values.
+@arg code : Code.
+@ret Value.
+*/
+template <class T, size_t N>
+inline T decode(const std::array<T, N>& codes, uint8_t code)
+{
+    GOOSEEYE_REQUIRE(code < N, std::runtime_error);
+    return codes[code];
+}
+
+/*
+Write a value.
+
+@arg stream : Output stream.
+@arg value : Value (trivially copyable).
+*/
+template <class T>
+inline void write(std::ostream& stream, const T& value)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable type required.");
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/*
+Write an array, preceded by its size.
+
+@arg stream : Output stream.
+@arg data : Array [n].
+@arg n : Size of the array.
+*/
+template <class T>
+inline void write(std::ostream& stream, const T* data, size_t n)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable type required.");
+    write(stream, static_cast<uint64_t>(n));
+    stream.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+/*
+Read a value.
+
+@arg stream : Input stream.
+@ret Value.
+*/
+template <class T>
+inline T read(std::istream& stream)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable type required.");
+    T ret;
+    stream.read(reinterpret_cast<char*>(&ret), sizeof(T));
+    GOOSEEYE_REQUIRE(stream, std::runtime_error);
+    return ret;
+}
+
+/*
+Read an array written by "write".
+
+@arg stream : Input stream.
+@ret Array.
+*/
+template <class T>
+inline std::vector<T> read_vector(std::istream& stream)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable type required.");
+    std::vector<T> ret(static_cast<size_t>(read<uint64_t>(stream)));
+    std::streamsize n = static_cast<std::streamsize>(ret.size() * sizeof(T));
+    stream.read(reinterpret_cast<char*>(ret.data()), n);
+    GOOSEEYE_REQUIRE(stream, std::runtime_error);
+    return ret;
+}
+
+/*
+Read an array written by "write", of which the size is known.
+
+@arg stream : Input stream.
+@arg data : Array [n] (overwritten).
+@arg n : Size of the array (checked against the size that is read).
+*/
+template <class T>
+inline void read(std::istream& stream, T* data, size_t n)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Trivially copyable type required.");
+    GOOSEEYE_REQUIRE(read<uint64_t>(stream) == n, std::runtime_error);
+    stream.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(n * sizeof(T)));
+    GOOSEEYE_REQUIRE(stream, std::runtime_error);
+}
+
+} // namespace io
+
 } // namespace detail
 } // namespace GooseEYE
 
@@ -7,6 +7,8 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <sstream>
+
 #define FORCE_IMPORT_ARRAY
 #include <xtensor-python/pyarray.hpp>
 #include <xtensor-python/pytensor.hpp>
@@ -84,6 +86,20 @@ PYBIND11_MODULE(_GooseEYE, m)
         .value("full", GooseEYE::path_mode::full)
         .export_values();
 
+    py::enum_<GooseEYE::compute_mode>(m, "compute_mode")
+        .value("direct", GooseEYE::compute_mode::direct)
+        .value("fft", GooseEYE::compute_mode::fft)
+        .value("binary", GooseEYE::compute_mode::binary)
+        .value("sparse", GooseEYE::compute_mode::sparse)
+        .value("unpadded", GooseEYE::compute_mode::unpadded)
+        .export_values();
+
+    py::enum_<GooseEYE::accumulator>(m, "accumulator")
+        .value("floating", GooseEYE::accumulator::floating)
+        .value("uint32", GooseEYE::accumulator::uint32)
+        .value("uint64", GooseEYE::accumulator::uint64)
+        .export_values();
+
     m.def(
         "path",
         &GooseEYE::path,
@@ -222,6 +238,18 @@ PYBIND11_MODULE(_GooseEYE, m)
         py::arg("names"),
         py::arg("periodic") = true);
 
+    py::class_<GooseEYE::PackedMask>(m, "PackedMask")
+
+        .def(py::init<const xt::pyarray<int>&>(), "PackedMask", py::arg("mask"))
+
+        .def_property_readonly("shape", &GooseEYE::PackedMask::shape)
+
+        .def("any", &GooseEYE::PackedMask::any)
+
+        .def("unpack", &GooseEYE::PackedMask::unpack)
+
+        .def("__repr__", [](const GooseEYE::PackedMask&) { return "<GooseEYE.PackedMask>"; });
+
     py::class_<GooseEYE::Ensemble>(m, "Ensemble")
 
         // Constructors
@@ -233,12 +261,38 @@ PYBIND11_MODULE(_GooseEYE, m)
             py::arg("periodic") = true,
             py::arg("variance") = false)
 
+        .def("set_threads", &GooseEYE::Ensemble::set_threads, py::arg("nthreads"))
+
+        .def(
+            "set_autocorrelation",
+            &GooseEYE::Ensemble::set_autocorrelation,
+            py::arg("autocorrelation") = true)
+
+        .def("set_radial", &GooseEYE::Ensemble::set_radial, py::arg("h"), py::arg("width"))
+
+        .def("set_accumulator", &GooseEYE::Ensemble::set_accumulator, py::arg("type"))
+
+        .def(
+            "set_tiles",
+            &GooseEYE::Ensemble::set_tiles,
+            py::arg("anchors") = 0,
+            py::arg("rows") = 0,
+            py::arg("cache") = 262144)
+
         // Get ensemble averaged result or raw data, and distance
 
         .def("result", &GooseEYE::Ensemble::result)
 
         .def("variance", &GooseEYE::Ensemble::variance)
 
+        .def("standard_error", &GooseEYE::Ensemble::standard_error)
+
+        .def("result_radial", &GooseEYE::Ensemble::result_radial)
+
+        .def("variance_radial", &GooseEYE::Ensemble::variance_radial)
+
+        .def("distance_radial", &GooseEYE::Ensemble::distance_radial)
+
         .def("data_first", &GooseEYE::Ensemble::data_first)
 
         .def("data_second", &GooseEYE::Ensemble::data_second)
@@ -259,6 +313,38 @@ PYBIND11_MODULE(_GooseEYE, m)
             py::overload_cast<const std::vector<double>&, size_t>(
                 &GooseEYE::Ensemble::distance, py::const_))
 
+        // Merge, save, load
+
+        .def("merge", &GooseEYE::Ensemble::merge, py::arg("other"))
+
+        .def(
+            "__iadd__",
+            [](GooseEYE::Ensemble& self, const GooseEYE::Ensemble& other) -> GooseEYE::Ensemble& {
+                return self += other;
+            },
+            py::arg("other"))
+
+        .def(
+            "save",
+            py::overload_cast<const std::string&>(&GooseEYE::Ensemble::save, py::const_),
+            py::arg("filename"))
+
+        .def_static(
+            "load",
+            py::overload_cast<const std::string&>(&GooseEYE::Ensemble::load),
+            py::arg("filename"))
+
+        .def(py::pickle(
+            [](const GooseEYE::Ensemble& self) {
+                std::stringstream stream;
+                self.save(stream);
+                return py::bytes(stream.str());
+            },
+            [](const py::bytes& data) {
+                std::stringstream stream(static_cast<std::string>(data));
+                return GooseEYE::Ensemble::load(stream);
+            }))
+
         // Mean
 
         .def(
@@ -278,31 +364,196 @@ PYBIND11_MODULE(_GooseEYE, m)
 
         .def(
             "S2",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::S2<xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::S2<xt::pyarray<double>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(
+                &GooseEYE::Ensemble::S2<xt::pyarray<double>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                const GooseEYE::PackedMask&,
+                const GooseEYE::PackedMask&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::S2<xt::pyarray<double>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2_batch",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::S2_batch<xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2_batch",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::S2_batch<xt::pyarray<double>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2_batch",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(
+                &GooseEYE::Ensemble::S2_batch<xt::pyarray<double>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "S2_slab",
             py::overload_cast<const xt::pyarray<int>&, const xt::pyarray<int>&>(
-                &GooseEYE::Ensemble::S2<xt::pyarray<int>>),
+                &GooseEYE::Ensemble::S2_slab<xt::pyarray<int>>),
             py::arg("f"),
             py::arg("g"))
 
         .def(
-            "S2",
+            "S2_slab",
             py::overload_cast<const xt::pyarray<double>&, const xt::pyarray<double>&>(
-                &GooseEYE::Ensemble::S2<xt::pyarray<double>>),
+                &GooseEYE::Ensemble::S2_slab<xt::pyarray<double>>),
             py::arg("f"),
             py::arg("g"))
 
         .def(
-            "S2",
+            "S2_slab",
             py::overload_cast<
                 const xt::pyarray<double>&,
                 const xt::pyarray<double>&,
                 const xt::pyarray<int>&,
                 const xt::pyarray<int>&>(
-                &GooseEYE::Ensemble::S2<xt::pyarray<double>, xt::pyarray<int>>),
+                &GooseEYE::Ensemble::S2_slab<xt::pyarray<double>, xt::pyarray<int>>),
             py::arg("f"),
             py::arg("g"),
             py::arg("fmask"),
             py::arg("gmask"))
 
+        .def("S2_slab_end", &GooseEYE::Ensemble::S2_slab_end)
+
+        .def(
+            "S2_incremental",
+            py::overload_cast<const xt::pyarray<int>&>(
+                &GooseEYE::Ensemble::S2_incremental<xt::pyarray<int>>),
+            py::arg("f"))
+
+        .def(
+            "S2_incremental",
+            py::overload_cast<const xt::pyarray<double>&>(
+                &GooseEYE::Ensemble::S2_incremental<xt::pyarray<double>>),
+            py::arg("f"))
+
+        .def(
+            "S2_incremental",
+            py::overload_cast<const xt::pyarray<double>&, const xt::pyarray<int>&>(
+                &GooseEYE::Ensemble::S2_incremental<xt::pyarray<double>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("mask"))
+
+        .def(
+            "S2_update",
+            &GooseEYE::Ensemble::S2_update<xt::pyarray<size_t>, xt::pyarray<double>>,
+            py::arg("index"),
+            py::arg("old"),
+            py::arg("value"))
+
+        .def(
+            "S2_sampled",
+            py::overload_cast<const xt::pyarray<int>&, const xt::pyarray<int>&, size_t, uint64_t>(
+                &GooseEYE::Ensemble::S2_sampled<xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("samples"),
+            py::arg("seed") = 0)
+
+        .def(
+            "S2_sampled",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                size_t,
+                uint64_t>(&GooseEYE::Ensemble::S2_sampled<xt::pyarray<double>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("samples"),
+            py::arg("seed") = 0)
+
+        .def(
+            "S2_sampled",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                size_t,
+                uint64_t>(&GooseEYE::Ensemble::S2_sampled<xt::pyarray<int>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("samples"),
+            py::arg("seed") = 0)
+
+        .def(
+            "S2_sampled",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                size_t,
+                uint64_t>(&GooseEYE::Ensemble::S2_sampled<xt::pyarray<double>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("samples"),
+            py::arg("seed") = 0)
+
         // Height-Height Correlation Function
 
         .def(
@@ -322,10 +573,13 @@ PYBIND11_MODULE(_GooseEYE, m)
 
         .def(
             "C2",
-            py::overload_cast<const xt::pyarray<int>&, const xt::pyarray<int>&>(
-                &GooseEYE::Ensemble::C2<xt::pyarray<int>>),
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::C2<xt::pyarray<int>>),
             py::arg("f"),
-            py::arg("g"))
+            py::arg("g"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
 
         .def(
             "C2",
@@ -333,39 +587,88 @@ PYBIND11_MODULE(_GooseEYE, m)
                 const xt::pyarray<int>&,
                 const xt::pyarray<int>&,
                 const xt::pyarray<int>&,
-                const xt::pyarray<int>&>(
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(
                 &GooseEYE::Ensemble::C2<xt::pyarray<int>, xt::pyarray<int>>),
             py::arg("f"),
             py::arg("g"),
             py::arg("fmask"),
-            py::arg("gmask"))
+            py::arg("gmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "C2",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const GooseEYE::PackedMask&,
+                const GooseEYE::PackedMask&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::C2<xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "C2_batch",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::C2_batch<xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
+
+        .def(
+            "C2_batch",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(
+                &GooseEYE::Ensemble::C2_batch<xt::pyarray<int>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
 
         // Weighted 2-point correlation
 
         .def(
             "W2",
-            py::overload_cast<const xt::pyarray<int>&, const xt::pyarray<int>&>(
-                &GooseEYE::Ensemble::W2<xt::pyarray<int>>),
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::W2<xt::pyarray<int>>),
             py::arg("w"),
-            py::arg("f"))
+            py::arg("f"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
 
         .def(
             "W2",
-            py::overload_cast<const xt::pyarray<double>&, const xt::pyarray<double>&>(
-                &GooseEYE::Ensemble::W2<xt::pyarray<double>>),
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                GooseEYE::compute_mode>(&GooseEYE::Ensemble::W2<xt::pyarray<double>>),
             py::arg("w"),
-            py::arg("f"))
+            py::arg("f"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
 
         .def(
             "W2",
             py::overload_cast<
                 const xt::pyarray<double>&,
                 const xt::pyarray<double>&,
-                const xt::pyarray<int>&>(
+                const xt::pyarray<int>&,
+                GooseEYE::compute_mode>(
                 &GooseEYE::Ensemble::W2<xt::pyarray<double>, xt::pyarray<int>>),
             py::arg("w"),
             py::arg("f"),
-            py::arg("fmask"))
+            py::arg("fmask"),
+            py::arg("mode") = GooseEYE::compute_mode::direct)
 
         // Collapsed weighted 2-point correlation
 
@@ -419,6 +722,111 @@ PYBIND11_MODULE(_GooseEYE, m)
 
         .def("__repr__", [](const GooseEYE::Ensemble&) { return "<GooseEYE.Ensemble>"; });
 
+    py::class_<GooseEYE::EnsembleLags>(m, "EnsembleLags")
+
+        .def(
+            py::init<const xt::pytensor<ptrdiff_t, 2>&, bool>(),
+            "EnsembleLags",
+            py::arg("lags"),
+            py::arg("periodic") = true)
+
+        .def("set_threads", &GooseEYE::EnsembleLags::set_threads, py::arg("nthreads"))
+
+        .def("lags", &GooseEYE::EnsembleLags::lags)
+
+        .def("result", &GooseEYE::EnsembleLags::result)
+
+        .def("data_first", &GooseEYE::EnsembleLags::data_first)
+
+        .def("norm", &GooseEYE::EnsembleLags::norm)
+
+        .def(
+            "S2",
+            py::overload_cast<const xt::pyarray<double>&, const xt::pyarray<double>&>(
+                &GooseEYE::EnsembleLags::S2<xt::pyarray<double>>),
+            py::arg("f"),
+            py::arg("g"))
+
+        .def(
+            "S2",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&>(
+                &GooseEYE::EnsembleLags::S2<xt::pyarray<double>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"))
+
+        .def(
+            "C2",
+            py::overload_cast<const xt::pyarray<int>&, const xt::pyarray<int>&>(
+                &GooseEYE::EnsembleLags::C2<xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"))
+
+        .def(
+            "C2",
+            py::overload_cast<
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&>(
+                &GooseEYE::EnsembleLags::C2<xt::pyarray<int>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"))
+
+        .def("__repr__", [](const GooseEYE::EnsembleLags&) { return "<GooseEYE.EnsembleLags>"; });
+
+    py::class_<GooseEYE::EnsembleMultiscale>(m, "EnsembleMultiscale")
+
+        .def(
+            py::init<const std::vector<size_t>&, size_t, bool>(),
+            "EnsembleMultiscale",
+            py::arg("roi"),
+            py::arg("levels"),
+            py::arg("periodic") = true)
+
+        .def("set_threads", &GooseEYE::EnsembleMultiscale::set_threads, py::arg("nthreads"))
+
+        .def("lags", &GooseEYE::EnsembleMultiscale::lags)
+
+        .def("level", &GooseEYE::EnsembleMultiscale::level)
+
+        .def("result", &GooseEYE::EnsembleMultiscale::result)
+
+        .def("data_first", &GooseEYE::EnsembleMultiscale::data_first)
+
+        .def("norm", &GooseEYE::EnsembleMultiscale::norm)
+
+        .def(
+            "S2",
+            py::overload_cast<const xt::pyarray<double>&, const xt::pyarray<double>&>(
+                &GooseEYE::EnsembleMultiscale::S2<xt::pyarray<double>>),
+            py::arg("f"),
+            py::arg("g"))
+
+        .def(
+            "S2",
+            py::overload_cast<
+                const xt::pyarray<double>&,
+                const xt::pyarray<double>&,
+                const xt::pyarray<int>&,
+                const xt::pyarray<int>&>(
+                &GooseEYE::EnsembleMultiscale::S2<xt::pyarray<double>, xt::pyarray<int>>),
+            py::arg("f"),
+            py::arg("g"),
+            py::arg("fmask"),
+            py::arg("gmask"))
+
+        .def(
+            "__repr__",
+            [](const GooseEYE::EnsembleMultiscale&) { return "<GooseEYE.EnsembleMultiscale>"; });
+
     // distance
 
     m.def(
@@ -454,30 +862,34 @@ PYBIND11_MODULE(_GooseEYE, m)
         [](const std::vector<size_t>& roi,
            const xt::pyarray<int>& f,
            const xt::pyarray<int>& g,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.S2(f, g);
+            ensemble.S2(f, g, mode);
             return ensemble.result();
         },
         py::arg("roi"),
         py::arg("f"),
         py::arg("g"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     m.def(
         "S2",
         [](const std::vector<size_t>& roi,
            const xt::pyarray<double>& f,
            const xt::pyarray<double>& g,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.S2(f, g);
+            ensemble.S2(f, g, mode);
             return ensemble.result();
         },
         py::arg("roi"),
         py::arg("f"),
         py::arg("g"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     m.def(
         "S2",
@@ -486,9 +898,10 @@ PYBIND11_MODULE(_GooseEYE, m)
            const xt::pyarray<double>& g,
            const xt::pyarray<int>& fmask,
            const xt::pyarray<int>& gmask,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.S2(f, g, fmask, gmask);
+            ensemble.S2(f, g, fmask, gmask, mode);
             return ensemble.result();
         },
         py::arg("roi"),
@@ -496,7 +909,18 @@ PYBIND11_MODULE(_GooseEYE, m)
         py::arg("g"),
         py::arg("fmask"),
         py::arg("gmask"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
+
+    m.def(
+        "S2_matrix",
+        &GooseEYE::S2_matrix<xt::pyarray<int>>,
+        "2-point correlation of all pairs of phases.",
+        py::arg("roi"),
+        py::arg("labels"),
+        py::arg("nphases"),
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     // 2-point cluster
 
@@ -505,15 +929,17 @@ PYBIND11_MODULE(_GooseEYE, m)
         [](const std::vector<size_t>& roi,
            const xt::pyarray<int>& f,
            const xt::pyarray<int>& g,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.C2(f, g);
+            ensemble.C2(f, g, mode);
             return ensemble.result();
         },
         py::arg("roi"),
         py::arg("f"),
         py::arg("g"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     m.def(
         "C2",
@@ -522,9 +948,10 @@ PYBIND11_MODULE(_GooseEYE, m)
            const xt::pyarray<int>& g,
            const xt::pyarray<int>& fmask,
            const xt::pyarray<int>& gmask,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.C2(f, g, fmask, gmask);
+            ensemble.C2(f, g, fmask, gmask, mode);
             return ensemble.result();
         },
         py::arg("roi"),
@@ -532,7 +959,8 @@ PYBIND11_MODULE(_GooseEYE, m)
         py::arg("g"),
         py::arg("fmask"),
         py::arg("gmask"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     // Weighted 2-point correlation
 
@@ -541,30 +969,34 @@ PYBIND11_MODULE(_GooseEYE, m)
         [](const std::vector<size_t>& roi,
            const xt::pyarray<int>& w,
            const xt::pyarray<int>& f,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.W2(w, f);
+            ensemble.W2(w, f, mode);
             return ensemble.result();
         },
         py::arg("roi"),
         py::arg("w"),
         py::arg("f"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     m.def(
         "W2",
         [](const std::vector<size_t>& roi,
            const xt::pyarray<double>& w,
            const xt::pyarray<double>& f,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.W2(w, f);
+            ensemble.W2(w, f, mode);
             return ensemble.result();
         },
         py::arg("roi"),
         py::arg("w"),
         py::arg("f"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     m.def(
         "W2",
@@ -572,16 +1004,18 @@ PYBIND11_MODULE(_GooseEYE, m)
            const xt::pyarray<double>& w,
            const xt::pyarray<double>& f,
            const xt::pyarray<int>& fmask,
-           bool periodic) {
+           bool periodic,
+           GooseEYE::compute_mode mode) {
             GooseEYE::Ensemble ensemble(roi, periodic);
-            ensemble.W2(w, f, fmask);
+            ensemble.W2(w, f, fmask, mode);
             return ensemble.result();
         },
         py::arg("roi"),
         py::arg("w"),
         py::arg("f"),
         py::arg("fmask"),
-        py::arg("periodic") = true);
+        py::arg("periodic") = true,
+        py::arg("mode") = GooseEYE::compute_mode::direct);
 
     // Collapsed weighted 2-point correlation
 
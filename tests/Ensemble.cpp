@@ -1,6 +1,68 @@
 #define CATCH_CONFIG_MAIN
 #include <GooseEYE/GooseEYE.h>
 #include <catch2/catch_all.hpp>
+#include <sstream>
+#include <xtensor/xrandom.hpp>
+
+// Random images and masks (seeded) to compare two ways of adding a realization.
+struct Setup {
+    std::vector<size_t> roi;
+    xt::xarray<int> I; // binary image
+    xt::xarray<int> C; // labels
+    xt::xarray<double> D; // floating-point image
+    xt::xarray<int> fmask;
+    xt::xarray<int> gmask;
+    xt::xarray<int> wide_I; // as "I", twice as wide along the last axis (see "strided")
+    xt::xarray<double> wide_D; // as "D", twice as wide along the last axis
+    xt::xarray<int> wide_mask; // as "fmask", twice as wide along the last axis
+
+    Setup(std::vector<size_t> shape, const std::vector<size_t>& roi) : roi(roi)
+    {
+        xt::random::seed(0);
+        I = xt::random::randint<int>(shape, 0, 2);
+        C = xt::random::randint<int>(shape, 0, 3);
+        D = xt::random::rand<double>(shape);
+        fmask = xt::random::randint<int>(shape, 0, 10) < 2;
+        gmask = xt::random::randint<int>(shape, 0, 10) < 2;
+        shape.back() *= 2;
+        wide_I = xt::random::randint<int>(shape, 0, 2);
+        wide_D = xt::random::rand<double>(shape);
+        wide_mask = xt::random::randint<int>(shape, 0, 10) < 2;
+    }
+
+    // 1d, 2d, and 3d images, with the last axis not a multiple of 64 (the bits in a word).
+    static std::vector<Setup> all()
+    {
+        return {
+            Setup({150}, {21}),
+            Setup({21, 26}, {7, 10}),
+            Setup({21, 70}, {7, 67}),
+            Setup({6, 9, 130}, {3, 5, 65})};
+    }
+
+    // Strided view of every other item along the last axis (e.g. of "wide_I").
+    template <class T>
+    static auto strided(const T& a)
+    {
+        size_t n = a.shape(a.dimension() - 1);
+        return xt::strided_view(a, {xt::ellipsis(), xt::range(0, n, 2)});
+    }
+
+    // Require that "reference(ensemble)" and "other(ensemble)" give the same raw result,
+    // with and without periodicity.
+    template <class A, class B>
+    void require_equal(A reference, B other) const
+    {
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble a(roi, periodic);
+            GooseEYE::Ensemble b(roi, periodic);
+            reference(a);
+            other(b);
+            REQUIRE(xt::all(xt::equal(a.data_first(), b.data_first())));
+            REQUIRE(xt::all(xt::equal(a.norm(), b.norm())));
+        }
+    }
+};
 
 TEST_CASE("GooseEYE::Ensemble", "Ensemble.hpp")
 {
@@ -65,6 +127,915 @@ TEST_CASE("GooseEYE::Ensemble", "Ensemble.hpp")
         REQUIRE(xt::allclose(R, res));
     }
 
+    SECTION("S2 - fft")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 2);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+
+        for (auto roi : std::vector<std::vector<size_t>>{{5, 5}, {7, 10}}) {
+            GooseEYE::Ensemble direct(roi);
+            GooseEYE::Ensemble fft(roi);
+            direct.S2(I, I);
+            fft.S2(I, I, GooseEYE::compute_mode::fft);
+            REQUIRE(xt::all(xt::equal(direct.data_first(), fft.data_first())));
+            REQUIRE(xt::all(xt::equal(direct.norm(), fft.norm())));
+
+            GooseEYE::Ensemble directd(roi);
+            GooseEYE::Ensemble fftd(roi);
+            directd.S2(D, D);
+            fftd.S2(D, D, GooseEYE::compute_mode::fft);
+            REQUIRE(xt::allclose(directd.result(), fftd.result()));
+        }
+
+        xt::xarray<int> J = xt::random::randint<int>({9, 8, 11}, 0, 2);
+        xt::xarray<double> a = GooseEYE::S2({5, 5, 5}, J, J);
+        xt::xarray<double> b = GooseEYE::S2({5, 5, 5}, J, J, true, GooseEYE::compute_mode::fft);
+        REQUIRE(xt::allclose(a, b));
+    }
+
+    SECTION("S2 - fft, masked")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 2);
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble direct({7, 10}, periodic);
+            GooseEYE::Ensemble fft({7, 10}, periodic);
+            direct.S2(D, D, fmask, gmask);
+            fft.S2(D, D, fmask, gmask, GooseEYE::compute_mode::fft);
+            REQUIRE(xt::allclose(direct.data_first(), fft.data_first()));
+            REQUIRE(xt::all(xt::equal(direct.norm(), fft.norm())));
+
+            GooseEYE::Ensemble directi({7, 10}, periodic);
+            GooseEYE::Ensemble ffti({7, 10}, periodic);
+            directi.S2(I, I);
+            ffti.S2(I, I, GooseEYE::compute_mode::fft);
+            REQUIRE(xt::all(xt::equal(directi.data_first(), ffti.data_first())));
+            REQUIRE(xt::all(xt::equal(directi.norm(), ffti.norm())));
+        }
+    }
+
+    SECTION("S2 - binary")
+    {
+        auto binary = GooseEYE::compute_mode::binary;
+
+        for (auto& s : Setup::all()) {
+            s.require_equal(
+                [&](auto& e) { e.S2(s.I, s.I, s.fmask, s.gmask); },
+                [&](auto& e) { e.S2(s.I, s.I, s.fmask, s.gmask, binary); });
+
+            // strided views
+            auto f = Setup::strided(s.wide_I);
+            auto mask = Setup::strided(s.wide_mask);
+            xt::xarray<int> fcopy = f;
+            xt::xarray<int> mcopy = mask;
+            s.require_equal(
+                [&](auto& e) { e.S2(fcopy, fcopy, mcopy, mcopy); },
+                [&](auto& e) { e.S2(f, f, mask, mask, binary); });
+        }
+    }
+
+    SECTION("C2 - fft")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 4);
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            xt::xarray<double> a = GooseEYE::C2({7, 10}, I, I, fmask, gmask, periodic);
+            xt::xarray<double> b = GooseEYE::C2(
+                {7, 10}, I, I, fmask, gmask, periodic, GooseEYE::compute_mode::fft);
+            REQUIRE(xt::all(xt::equal(a, b)));
+        }
+
+        // one label and a large region-of-interest: computed by transforms
+        xt::xarray<int> J = xt::random::randint<int>({64, 64}, 0, 2);
+        std::vector<std::vector<size_t>> pad = {{0, 0}, {31, 31}, {31, 31}};
+        REQUIRE(GooseEYE::detail::fft::faster(2, std::vector<size_t>{1, 64, 64}, pad));
+        REQUIRE(!GooseEYE::detail::fft::faster(4, std::vector<size_t>{1, 21, 26}, pad));
+
+        for (bool periodic : {true, false}) {
+            xt::xarray<double> a = GooseEYE::C2({63, 63}, J, J, periodic);
+            xt::xarray<double> b =
+                GooseEYE::C2({63, 63}, J, J, periodic, GooseEYE::compute_mode::fft);
+            REQUIRE(xt::all(xt::equal(a, b)));
+        }
+    }
+
+    SECTION("heightheight")
+    {
+        xt::xarray<double> f = xt::arange<double>(20);
+        xt::xarray<double> R = {2, 1, 0, 1, 2};
+        xt::xarray<double> res = GooseEYE::heightheight({5}, f, false);
+        REQUIRE(xt::allclose(R, res));
+    }
+
+    SECTION("autocorrelation")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 3);
+        xt::xarray<int> mask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> zero = xt::zeros<int>(mask.shape());
+
+        for (bool periodic : {true, false}) {
+            xt::xarray<int> fmask = periodic ? zero : mask;
+
+            GooseEYE::Ensemble full({7, 10}, periodic, true);
+            GooseEYE::Ensemble half({7, 10}, periodic, true);
+            half.set_autocorrelation();
+            full.S2(D, D, fmask, fmask);
+            half.S2(D, D, fmask, fmask);
+            REQUIRE(xt::allclose(full.result(), half.result()));
+            REQUIRE(xt::all(xt::equal(full.norm(), half.norm())));
+
+            GooseEYE::Ensemble cfull({7, 10}, periodic);
+            GooseEYE::Ensemble chalf({7, 10}, periodic);
+            chalf.set_autocorrelation();
+            cfull.C2(I, I, fmask, fmask);
+            chalf.C2(I, I, fmask, fmask);
+            REQUIRE(xt::all(xt::equal(cfull.data_first(), chalf.data_first())));
+            REQUIRE(xt::all(xt::equal(cfull.norm(), chalf.norm())));
+
+            GooseEYE::Ensemble hfull({7, 10}, periodic, true);
+            GooseEYE::Ensemble hhalf({7, 10}, periodic, true);
+            hhalf.set_autocorrelation();
+            hfull.heightheight(D, fmask);
+            hhalf.heightheight(D, fmask);
+            REQUIRE(xt::allclose(hfull.result(), hhalf.result()));
+            REQUIRE(xt::allclose(hfull.variance(), hhalf.variance()));
+        }
+
+        GooseEYE::Ensemble masked({7, 10}, true);
+        masked.set_autocorrelation();
+        REQUIRE_THROWS_AS(masked.S2(D, D, mask, mask), std::out_of_range);
+    }
+
+    SECTION("radial")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        std::vector<double> h = {1.0, 0.5};
+        double width = 0.75;
+
+        GooseEYE::Ensemble dense({7, 10}, true, true);
+        GooseEYE::Ensemble radial({7, 10}, true, true);
+        radial.set_radial(h, width);
+
+        for (auto* ensemble : {&dense, &radial}) {
+            ensemble->heightheight(D);
+            ensemble->heightheight(xt::xarray<double>(2.0 * D));
+        }
+
+        // bin the dense result
+        xt::xarray<size_t> bin = xt::floor(dense.distance(h) / width);
+        size_t nbins = radial.result_radial().size();
+        xt::xarray<double> first = xt::zeros<double>({nbins});
+        xt::xarray<double> norm = xt::zeros<double>({nbins});
+        xt::xarray<double> data_first = dense.data_first();
+        xt::xarray<double> data_norm = dense.norm();
+
+        REQUIRE(xt::amax(bin)() + 1 == nbins);
+
+        for (size_t i = 0; i < bin.size(); ++i) {
+            first(bin.flat(i)) += data_first.flat(i);
+            norm(bin.flat(i)) += data_norm.flat(i);
+        }
+
+        REQUIRE(xt::allclose(xt::sqrt(first / norm), radial.result_radial()));
+        REQUIRE(radial.distance_radial().size() == nbins);
+
+        // auto-correlation, threads: the same bins
+        GooseEYE::Ensemble half({7, 10}, true, true);
+        GooseEYE::Ensemble threads({7, 10}, true, true);
+        half.set_radial(h, width);
+        half.set_autocorrelation();
+        threads.set_radial(h, width);
+        threads.set_threads(3);
+
+        for (auto* ensemble : {&half, &threads}) {
+            ensemble->heightheight(D);
+            ensemble->heightheight(xt::xarray<double>(2.0 * D));
+        }
+
+        REQUIRE(xt::allclose(half.result_radial(), radial.result_radial()));
+        REQUIRE(xt::allclose(half.variance_radial(), radial.variance_radial()));
+        REQUIRE(xt::allclose(threads.result_radial(), radial.result_radial()));
+        REQUIRE(xt::allclose(threads.variance_radial(), radial.variance_radial()));
+    }
+
+    SECTION("S2_matrix")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 3);
+
+        for (bool periodic : {true, false}) {
+            xt::xarray<double> direct = GooseEYE::S2_matrix({7, 10}, I, 3, periodic);
+            xt::xarray<double> fft =
+                GooseEYE::S2_matrix({7, 10}, I, 3, periodic, GooseEYE::compute_mode::fft);
+
+            REQUIRE(xt::has_shape(direct, std::vector<size_t>{3, 3, 7, 10}));
+            REQUIRE(xt::allclose(direct, fft));
+
+            for (int a = 0; a < 3; ++a) {
+                for (int b = 0; b < 3; ++b) {
+                    xt::xarray<int> Ia = xt::equal(I, a);
+                    xt::xarray<int> Ib = xt::equal(I, b);
+                    xt::xarray<double> S2 = GooseEYE::S2({7, 10}, Ia, Ib, periodic);
+                    REQUIRE(xt::allclose(xt::view(direct, a, b), S2));
+                }
+            }
+        }
+
+        REQUIRE_THROWS_AS(
+            GooseEYE::S2_matrix({7, 10}, I, 3, true, GooseEYE::compute_mode::binary),
+            std::out_of_range);
+    }
+
+    SECTION("S2, C2 - batch")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({5, 21, 26});
+        xt::xarray<int> I = xt::random::randint<int>({5, 21, 26}, 0, 3);
+        xt::xarray<int> fmask = xt::random::randint<int>({5, 21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({5, 21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            for (auto mode : {GooseEYE::compute_mode::direct, GooseEYE::compute_mode::fft}) {
+                GooseEYE::Ensemble loop({7, 10}, periodic);
+                GooseEYE::Ensemble batch({7, 10}, periodic);
+                GooseEYE::Ensemble cloop({7, 10}, periodic);
+                GooseEYE::Ensemble cbatch({7, 10}, periodic);
+                batch.set_threads(2);
+                cbatch.set_threads(2);
+
+                for (size_t s = 0; s < D.shape(0); ++s) {
+                    xt::xarray<double> d = xt::view(D, s);
+                    xt::xarray<int> i = xt::view(I, s);
+                    xt::xarray<int> fm = xt::view(fmask, s);
+                    xt::xarray<int> gm = xt::view(gmask, s);
+                    loop.S2(d, d, fm, gm, mode);
+                    cloop.C2(i, i, fm, gm, mode);
+                }
+
+                batch.S2_batch(D, D, fmask, gmask, mode);
+                cbatch.C2_batch(I, I, fmask, gmask, mode);
+
+                REQUIRE(xt::allclose(loop.data_first(), batch.data_first()));
+                REQUIRE(xt::all(xt::equal(loop.norm(), batch.norm())));
+                REQUIRE(xt::all(xt::equal(cloop.data_first(), cbatch.data_first())));
+                REQUIRE(xt::all(xt::equal(cloop.norm(), cbatch.norm())));
+            }
+        }
+    }
+
+    SECTION("S2 - compile-time region-of-interest")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({20, 15, 17}, 0, 2);
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble ensemble({5, 6}, periodic);
+            GooseEYE::Ensemble fixed({5, 6}, periodic);
+            GooseEYE::Ensemble view({5, 6}, periodic);
+
+            for (size_t s = 0; s < I.shape(0); ++s) {
+                xt::xarray<int> i = xt::view(I, s);
+                ensemble.S2(i, i);
+                fixed.S2<5, 6>(i, i);
+                view.S2<5, 6>(xt::view(I, s), xt::view(I, s));
+            }
+
+            REQUIRE(xt::all(xt::equal(ensemble.data_first(), fixed.data_first())));
+            REQUIRE(xt::all(xt::equal(ensemble.norm(), fixed.norm())));
+            REQUIRE(xt::all(xt::equal(ensemble.data_first(), view.data_first())));
+
+            xt::xarray<int> i = xt::view(I, 0);
+            auto res = GooseEYE::S2({5, 6}, i, i, periodic);
+            REQUIRE(xt::allclose(res, GooseEYE::S2<5, 6>(i, i, periodic)));
+        }
+    }
+
+    SECTION("S2, C2, W2 - narrow types")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 200);
+        xt::xarray<uint8_t> U = I;
+        xt::xarray<double> D = I;
+        xt::xarray<float> F = I;
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble s2({7, 10}, periodic);
+            GooseEYE::Ensemble s2_narrow({7, 10}, periodic);
+            s2.S2(I, I, fmask, gmask);
+            s2_narrow.S2(U, U, fmask, gmask);
+            REQUIRE(xt::all(xt::equal(s2.data_first(), s2_narrow.data_first())));
+            REQUIRE(xt::all(xt::equal(s2.norm(), s2_narrow.norm())));
+
+            GooseEYE::Ensemble c2({7, 10}, periodic);
+            GooseEYE::Ensemble c2_narrow({7, 10}, periodic);
+            c2.C2(I, I, fmask, gmask);
+            c2_narrow.C2(U, U, fmask, gmask);
+            REQUIRE(xt::all(xt::equal(c2.data_first(), c2_narrow.data_first())));
+            REQUIRE(xt::all(xt::equal(c2.norm(), c2_narrow.norm())));
+
+            GooseEYE::Ensemble w2({7, 10}, periodic);
+            GooseEYE::Ensemble w2_narrow({7, 10}, periodic);
+            w2.W2(D, D, gmask);
+            w2_narrow.W2(F, F, gmask);
+            REQUIRE(xt::all(xt::equal(w2.data_first(), w2_narrow.data_first())));
+            REQUIRE(xt::all(xt::equal(w2.norm(), w2_narrow.norm())));
+        }
+    }
+
+    SECTION("S2, heightheight - tiles")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> f = xt::random::rand<double>({9, 11, 40});
+        xt::xarray<int> mask = xt::random::randint<int>({9, 11, 40}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble s2({5, 7, 9}, periodic);
+            GooseEYE::Ensemble hh({5, 7, 9}, periodic);
+            s2.S2(f, f, mask, mask);
+            hh.heightheight(f, mask);
+
+            std::vector<std::array<size_t, 3>> tiles = {
+                {0, 0, 262144}, {1, 1, 262144}, {7, 3, 262144}, {100, 2, 262144}, {0, 0, 1024}};
+
+            for (auto& tile : tiles) {
+                GooseEYE::Ensemble s2_tiles({5, 7, 9}, periodic);
+                GooseEYE::Ensemble hh_tiles({5, 7, 9}, periodic);
+                s2_tiles.set_tiles(tile[0], tile[1], tile[2]);
+                hh_tiles.set_tiles(tile[0], tile[1], tile[2]);
+                s2_tiles.S2(f, f, mask, mask);
+                hh_tiles.heightheight(f, mask);
+                REQUIRE(xt::all(xt::equal(s2.data_first(), s2_tiles.data_first())));
+                REQUIRE(xt::all(xt::equal(s2.norm(), s2_tiles.norm())));
+                REQUIRE(xt::all(xt::equal(hh.data_first(), hh_tiles.data_first())));
+                REQUIRE(xt::all(xt::equal(hh.data_second(), hh_tiles.data_second())));
+                REQUIRE(xt::all(xt::equal(hh.norm(), hh_tiles.norm())));
+            }
+        }
+    }
+
+    SECTION("accumulator")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 2);
+        xt::xarray<int> C = xt::random::randint<int>({21, 26}, 0, 3);
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (auto type : {GooseEYE::accumulator::uint32, GooseEYE::accumulator::uint64}) {
+            GooseEYE::Ensemble s2({7, 10});
+            GooseEYE::Ensemble c2({7, 10});
+            GooseEYE::Ensemble l({7, 10});
+            GooseEYE::Ensemble s2_int({7, 10});
+            GooseEYE::Ensemble c2_int({7, 10});
+            GooseEYE::Ensemble l_int({7, 10});
+            s2_int.set_accumulator(type);
+            c2_int.set_accumulator(type);
+            l_int.set_accumulator(type);
+            c2_int.set_threads(3);
+
+            for (size_t i = 0; i < 3; ++i) {
+                s2.S2(I, I, fmask, gmask);
+                s2_int.S2(I, I, fmask, gmask);
+                s2.S2(I, I, GooseEYE::compute_mode::binary);
+                s2_int.S2(I, I, GooseEYE::compute_mode::binary);
+                c2.C2(C, C, fmask, gmask);
+                c2_int.C2(C, C, fmask, gmask);
+                l.L(I);
+                l_int.L(I);
+            }
+
+            REQUIRE(xt::all(xt::equal(s2.result(), s2_int.result())));
+            REQUIRE(xt::all(xt::equal(s2.data_first(), s2_int.data_first())));
+            REQUIRE(xt::all(xt::equal(s2.norm(), s2_int.norm())));
+            REQUIRE(xt::all(xt::equal(c2.result(), c2_int.result())));
+            REQUIRE(xt::all(xt::equal(l.result(), l_int.result())));
+
+            // not a count: the realization is not added
+            xt::xarray<double> D = xt::random::rand<double>({21, 26});
+            REQUIRE_THROWS_AS(s2_int.S2(D, D), std::out_of_range);
+            REQUIRE(xt::all(xt::equal(s2.data_first(), s2_int.data_first())));
+        }
+    }
+
+    SECTION("S2, W2 - sparse")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 100) < 3;
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<double> W = I * D;
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        auto sparse = GooseEYE::compute_mode::sparse;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble direct({7, 10}, periodic);
+            GooseEYE::Ensemble other({7, 10}, periodic);
+            direct.S2(I, I);
+            other.S2(I, I, sparse);
+            REQUIRE(xt::all(xt::equal(direct.data_first(), other.data_first())));
+            REQUIRE(xt::all(xt::equal(direct.norm(), other.norm())));
+
+            direct.S2(I, I, fmask, gmask);
+            other.S2(I, I, fmask, gmask, sparse);
+            REQUIRE(xt::all(xt::equal(direct.data_first(), other.data_first())));
+            REQUIRE(xt::all(xt::equal(direct.norm(), other.norm())));
+
+            GooseEYE::Ensemble wdirect({7, 10}, periodic);
+            GooseEYE::Ensemble wsparse({7, 10}, periodic);
+            wdirect.W2(W, D, gmask);
+            wsparse.W2(W, D, gmask, sparse);
+            REQUIRE(xt::all(xt::equal(wdirect.data_first(), wsparse.data_first())));
+            REQUIRE(xt::all(xt::equal(wdirect.norm(), wsparse.norm())));
+        }
+    }
+
+    SECTION("S2, C2 - packed masks")
+    {
+        Setup s2d({21, 26}, {7, 10});
+        GooseEYE::PackedMask packed(s2d.fmask);
+        REQUIRE(packed.data().size() == 21 + 1);
+        REQUIRE(packed(3, 4, 0) == (s2d.fmask(3, 4) != 0));
+
+        for (auto& s : Setup::all()) {
+            GooseEYE::PackedMask fpacked(s.fmask);
+            GooseEYE::PackedMask gpacked(s.gmask);
+            REQUIRE(xt::all(xt::equal(fpacked.unpack(), s.fmask)));
+            REQUIRE(xt::all(xt::equal(gpacked.unpack(), s.gmask)));
+
+            s.require_equal(
+                [&](auto& e) { e.S2(s.D, s.D, s.fmask, s.gmask); },
+                [&](auto& e) { e.S2(s.D, s.D, fpacked, gpacked); });
+
+            s.require_equal(
+                [&](auto& e) { e.C2(s.C, s.C, s.fmask, s.gmask); },
+                [&](auto& e) { e.C2(s.C, s.C, fpacked, gpacked); });
+
+            // packed from a strided view
+            auto mask = Setup::strided(s.wide_mask);
+            xt::xarray<int> mcopy = mask;
+            xt::xarray<double> D = Setup::strided(s.wide_D);
+            GooseEYE::PackedMask vpacked(mask);
+            REQUIRE(xt::all(xt::equal(vpacked.unpack(), mcopy)));
+
+            s.require_equal(
+                [&](auto& e) { e.S2(D, D, mcopy, mcopy); },
+                [&](auto& e) { e.S2(D, D, vpacked, vpacked); });
+        }
+    }
+
+    SECTION("S2, C2, W2, heightheight - without masks")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 3);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<int> mask = xt::zeros<int>({21, 26});
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble masked({7, 10}, periodic);
+            GooseEYE::Ensemble other({7, 10}, periodic);
+            masked.S2(D, D, mask, mask);
+            other.S2(D, D);
+            REQUIRE(xt::all(xt::equal(masked.data_first(), other.data_first())));
+            REQUIRE(xt::all(xt::equal(masked.norm(), other.norm())));
+
+            GooseEYE::Ensemble cmasked({7, 10}, periodic);
+            GooseEYE::Ensemble cother({7, 10}, periodic);
+            cmasked.C2(I, I, mask, mask);
+            cother.C2(I, I);
+            REQUIRE(xt::all(xt::equal(cmasked.data_first(), cother.data_first())));
+            REQUIRE(xt::all(xt::equal(cmasked.norm(), cother.norm())));
+
+            GooseEYE::Ensemble wmasked({7, 10}, periodic);
+            GooseEYE::Ensemble wother({7, 10}, periodic);
+            wmasked.W2(D, D, mask);
+            wother.W2(D, D);
+            REQUIRE(xt::all(xt::equal(wmasked.data_first(), wother.data_first())));
+            REQUIRE(xt::all(xt::equal(wmasked.norm(), wother.norm())));
+
+            GooseEYE::Ensemble hmasked({7, 10}, periodic, true);
+            GooseEYE::Ensemble hother({7, 10}, periodic, true);
+            hmasked.heightheight(D, mask);
+            hother.heightheight(D);
+            REQUIRE(xt::all(xt::equal(hmasked.data_first(), hother.data_first())));
+            REQUIRE(xt::all(xt::equal(hmasked.data_second(), hother.data_second())));
+            REQUIRE(xt::all(xt::equal(hmasked.norm(), hother.norm())));
+        }
+    }
+
+    SECTION("S2, C2, W2 - unpadded")
+    {
+        auto unpadded = GooseEYE::compute_mode::unpadded;
+
+        for (auto& s : Setup::all()) {
+            s.require_equal(
+                [&](auto& e) { e.S2(s.D, s.D, s.fmask, s.gmask); },
+                [&](auto& e) { e.S2(s.D, s.D, s.fmask, s.gmask, unpadded); });
+
+            s.require_equal(
+                [&](auto& e) { e.C2(s.C, s.C, s.fmask, s.gmask); },
+                [&](auto& e) { e.C2(s.C, s.C, s.fmask, s.gmask, unpadded); });
+
+            s.require_equal(
+                [&](auto& e) { e.W2(s.D, s.D, s.gmask); },
+                [&](auto& e) { e.W2(s.D, s.D, s.gmask, unpadded); });
+
+            // strided views
+            auto f = Setup::strided(s.wide_D);
+            auto mask = Setup::strided(s.wide_mask);
+            xt::xarray<double> fcopy = f;
+            xt::xarray<int> mcopy = mask;
+            s.require_equal(
+                [&](auto& e) { e.S2(fcopy, fcopy, mcopy, mcopy); },
+                [&](auto& e) { e.S2(f, f, mask, mask, unpadded); });
+        }
+
+        // views (in-place with an offset) and expressions
+        Setup s({21, 26}, {7, 10});
+        xt::xarray<double> B = xt::random::rand<double>({2, 21, 52});
+        auto offset = xt::view(B, 1);
+        auto expression = s.D * 2.0;
+        xt::xarray<double> Eoffset = offset;
+        xt::xarray<double> Eexpression = expression;
+
+        s.require_equal(
+            [&](auto& e) {
+                e.S2(Eoffset, Eoffset, s.fmask, s.gmask);
+                e.S2(Eexpression, Eexpression, s.fmask, s.gmask);
+            },
+            [&](auto& e) {
+                e.S2(offset, offset, s.fmask, s.gmask, unpadded);
+                e.S2(expression, expression, s.fmask, s.gmask, unpadded);
+            });
+
+        // batch
+        GooseEYE::Ensemble bdirect({7, 10}, false);
+        GooseEYE::Ensemble bother({7, 10}, false);
+        xt::xarray<int> bmask = xt::zeros<int>(B.shape());
+        bdirect.S2_batch(B, B, bmask, bmask);
+        bother.S2_batch(B, B, bmask, bmask, unpadded);
+        REQUIRE(xt::all(xt::equal(bdirect.data_first(), bother.data_first())));
+        REQUIRE(xt::all(xt::equal(bdirect.norm(), bother.norm())));
+
+        // not supported
+        GooseEYE::Ensemble sparse({7, 10});
+        REQUIRE_THROWS_AS(
+            sparse.C2(s.C, s.C, s.fmask, s.gmask, GooseEYE::compute_mode::sparse),
+            std::out_of_range);
+    }
+
+    SECTION("S2 - slab")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({23, 21, 26}, 0, 3);
+        xt::xarray<int> fmask = xt::random::randint<int>({23, 21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({23, 21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            for (size_t thickness : {1, 4, 30}) {
+                GooseEYE::Ensemble full({7, 10, 9}, periodic);
+                GooseEYE::Ensemble slab({7, 10, 9}, periodic);
+                full.S2(I, I, fmask, gmask);
+
+                for (size_t h = 0; h < I.shape(0); h += thickness) {
+                    auto r = xt::range(h, std::min(h + thickness, I.shape(0)));
+                    xt::xarray<int> i = xt::view(I, r);
+                    xt::xarray<int> fm = xt::view(fmask, r);
+                    xt::xarray<int> gm = xt::view(gmask, r);
+                    slab.S2_slab(i, i, fm, gm);
+                }
+                slab.S2_slab_end();
+
+                REQUIRE(xt::all(xt::equal(full.data_first(), slab.data_first())));
+                REQUIRE(xt::all(xt::equal(full.norm(), slab.norm())));
+            }
+        }
+    }
+
+    SECTION("S2, C2 - list of lags")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 3);
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        // principal axes of the region-of-interest {7, 10}
+        xt::xtensor<ptrdiff_t, 2> lags = xt::zeros<ptrdiff_t>({17, 2});
+        for (size_t i = 0; i < 7; ++i) {
+            lags(i, 0) = static_cast<ptrdiff_t>(i) - 3;
+        }
+        for (size_t j = 0; j < 10; ++j) {
+            lags(7 + j, 1) = static_cast<ptrdiff_t>(j) - 4;
+        }
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble s2({7, 10}, periodic);
+            GooseEYE::Ensemble c2({7, 10}, periodic);
+            GooseEYE::EnsembleLags s2_lags(lags, periodic);
+            GooseEYE::EnsembleLags c2_lags(lags, periodic);
+            s2.S2(D, D, fmask, gmask);
+            c2.C2(I, I, fmask, gmask);
+            s2_lags.S2(D, D, fmask, gmask);
+            c2_lags.C2(I, I, fmask, gmask);
+
+            GooseEYE::Ensemble s2_unmasked({7, 10}, periodic);
+            GooseEYE::EnsembleLags s2_lags_unmasked(lags, periodic);
+            s2_unmasked.S2(D, D);
+            s2_lags_unmasked.S2(D, D);
+
+            for (size_t k = 0; k < lags.shape(0); ++k) {
+                size_t i = static_cast<size_t>(lags(k, 0) + 3);
+                size_t j = static_cast<size_t>(lags(k, 1) + 4);
+                REQUIRE(s2_lags.data_first()(k) == s2.data_first()(i, j));
+                REQUIRE(s2_lags.norm()(k) == s2.norm()(i, j));
+                REQUIRE(c2_lags.data_first()(k) == c2.data_first()(i, j));
+                REQUIRE(c2_lags.norm()(k) == c2.norm()(i, j));
+                REQUIRE(s2_lags_unmasked.data_first()(k) == s2_unmasked.data_first()(i, j));
+                REQUIRE(s2_lags_unmasked.norm()(k) == s2_unmasked.norm()(i, j));
+            }
+        }
+
+        // 1d: the lags run along the signal, also if the threads split it
+        xt::xarray<double> S = xt::random::rand<double>({200});
+        xt::xtensor<ptrdiff_t, 2> lags1d = xt::zeros<ptrdiff_t>({21, 1});
+        for (size_t i = 0; i < 21; ++i) {
+            lags1d(i, 0) = static_cast<ptrdiff_t>(i) - 10;
+        }
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble s2({21}, periodic);
+            GooseEYE::EnsembleLags s2_lags(lags1d, periodic);
+            s2_lags.set_threads(4);
+            s2.S2(S, S);
+            s2_lags.S2(S, S);
+            REQUIRE(xt::allclose(s2_lags.data_first(), s2.data_first()));
+            REQUIRE(xt::all(xt::equal(s2_lags.norm(), s2.norm())));
+        }
+    }
+
+    SECTION("S2 - multiscale")
+    {
+        // image of blocks of 2 x 2 pixels: coarsening it is exact
+        xt::random::seed(0);
+        xt::xarray<int> C = xt::random::randint<int>({11, 13}, 0, 2);
+        xt::xarray<int> I = xt::zeros<int>({22, 26});
+        for (size_t i = 0; i < I.shape(0); ++i) {
+            for (size_t j = 0; j < I.shape(1); ++j) {
+                I(i, j) = C(i / 2, j / 2);
+            }
+        }
+
+        GooseEYE::EnsembleMultiscale multiscale({7, 10}, 2);
+        multiscale.S2(I, I);
+        REQUIRE(xt::sum(xt::equal(multiscale.level(), 0))() == 70);
+
+        GooseEYE::EnsembleLags exact(multiscale.lags());
+        exact.S2(I, I);
+        REQUIRE(xt::allclose(multiscale.result(), exact.result()));
+
+        // shape not divisible by the coarsening factor: only without periodicity
+        xt::xarray<int> J = xt::view(I, xt::range(0, 21), xt::all());
+        GooseEYE::EnsembleMultiscale periodic({7, 10}, 2);
+        REQUIRE_THROWS_AS(periodic.S2(J, J), std::out_of_range);
+
+        GooseEYE::EnsembleMultiscale open({7, 10}, 2, false);
+        GooseEYE::EnsembleLags open_exact(open.lags(), false);
+        open.S2(J, J);
+        open_exact.S2(J, J);
+        xt::xarray<size_t> level = open.level();
+        for (size_t k = 0; k < level.size(); ++k) {
+            if (level(k) == 0) {
+                REQUIRE(open.data_first()(k) == open_exact.data_first()(k));
+                REQUIRE(open.norm()(k) == open_exact.norm()(k));
+            }
+        }
+    }
+
+    SECTION("S2 - sampled")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({51, 61}, 0, 2);
+        xt::xarray<int> mask = xt::random::randint<int>({51, 61}, 0, 10) < 2;
+        xt::xarray<int> one = xt::ones<int>({51, 61});
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble exact({7, 10}, periodic);
+            GooseEYE::Ensemble sampled({7, 10}, periodic);
+            exact.S2(I, I, mask, mask);
+            sampled.S2_sampled(I, I, mask, mask, 1000, 1);
+            sampled.S2_sampled(I, I, mask, mask, 1000, 2);
+            xt::xarray<double> error = xt::abs(sampled.result() - exact.result());
+            REQUIRE(xt::all(error <= 5.0 * sampled.standard_error()));
+
+            GooseEYE::Ensemble constant({7, 10}, periodic);
+            constant.S2_sampled(one, one, 500);
+            REQUIRE(xt::allclose(constant.result(), 1.0));
+            REQUIRE(xt::allclose(constant.standard_error(), 0.0));
+
+            // one sample: no estimate of the error
+            GooseEYE::Ensemble single({7, 10}, periodic);
+            single.S2_sampled(I, I, 1, 3);
+            REQUIRE(xt::all(xt::isfinite(single.standard_error())));
+            REQUIRE(xt::all(xt::equal(single.variance(), 0.0)));
+        }
+
+        // strided view: sampled as its copy
+        for (auto& s : Setup::all()) {
+            auto view = Setup::strided(s.wide_I);
+            xt::xarray<int> copy = view;
+            s.require_equal(
+                [&](auto& e) { e.S2_sampled(copy, copy, 500, 4); },
+                [&](auto& e) { e.S2_sampled(view, view, 500, 4); });
+        }
+    }
+
+    SECTION("S2 - incremental")
+    {
+        xt::random::seed(0);
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 3);
+        xt::xarray<int> mask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble full({7, 10}, periodic);
+            GooseEYE::Ensemble incremental({7, 10}, periodic);
+            xt::xarray<int> frame = I;
+            full.S2(frame, frame, mask, mask);
+            incremental.S2_incremental(frame, mask);
+
+            for (size_t t = 0; t < 4; ++t) {
+                xt::xarray<size_t> pixels = xt::arange<size_t>(I.size());
+                xt::xarray<size_t> index = xt::random::choice(pixels, 20, false);
+                xt::xarray<int> old = xt::index_view(xt::flatten(frame), index);
+                xt::xarray<int> value = xt::random::randint<int>(old.shape(), 0, 3);
+                for (size_t c = 0; c < index.size(); ++c) {
+                    frame.flat(index(c)) = value(c);
+                }
+                full.S2(frame, frame, mask, mask);
+                incremental.S2_update(index, old, value);
+
+                REQUIRE(xt::all(xt::equal(full.data_first(), incremental.data_first())));
+                REQUIRE(xt::all(xt::equal(full.norm(), incremental.norm())));
+            }
+        }
+    }
+
+    SECTION("threads")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<double> E = xt::random::rand<double>({21, 26});
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 2);
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble serial({7, 10}, periodic);
+            GooseEYE::Ensemble a({7, 10}, periodic);
+            GooseEYE::Ensemble b({7, 10}, periodic);
+            a.set_threads(3);
+            b.set_threads(3);
+
+            for (auto* ensemble : {&serial, &a, &b}) {
+                ensemble->S2(D, D, fmask, gmask);
+                ensemble->S2(D, E, fmask, gmask);
+            }
+
+            REQUIRE(xt::allclose(serial.data_first(), a.data_first()));
+            REQUIRE(xt::all(xt::equal(serial.norm(), a.norm())));
+            REQUIRE(xt::all(xt::equal(a.data_first(), b.data_first())));
+
+            GooseEYE::Ensemble Lserial({7, 7}, periodic);
+            GooseEYE::Ensemble Lthreads({7, 7}, periodic);
+            Lthreads.set_threads(4);
+            Lserial.L(I);
+            Lthreads.L(I);
+            REQUIRE(xt::all(xt::equal(Lserial.data_first(), Lthreads.data_first())));
+        }
+
+        // 1d: a single row of anchors, the threads split it along the signal
+        xt::xarray<int> S = xt::random::randint<int>({200}, 0, 2);
+        xt::xarray<int> Smask = xt::random::randint<int>({200}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble Sserial({21}, periodic);
+            GooseEYE::Ensemble Sthreads({21}, periodic);
+            Sthreads.set_threads(4);
+            Sserial.S2(S, S, Smask, Smask);
+            Sthreads.S2(S, S, Smask, Smask);
+            REQUIRE(xt::all(xt::equal(Sserial.data_first(), Sthreads.data_first())));
+            REQUIRE(xt::all(xt::equal(Sserial.norm(), Sthreads.norm())));
+
+            GooseEYE::Ensemble Userial({21}, periodic);
+            GooseEYE::Ensemble Uthreads({21}, periodic);
+            Uthreads.set_threads(4);
+            Userial.S2(S, S, GooseEYE::compute_mode::unpadded);
+            Uthreads.S2(S, S, GooseEYE::compute_mode::unpadded);
+            REQUIRE(xt::all(xt::equal(Userial.data_first(), Uthreads.data_first())));
+            REQUIRE(xt::all(xt::equal(Userial.norm(), Uthreads.norm())));
+        }
+    }
+
+    SECTION("merge, save, load")
+    {
+        xt::random::seed(0);
+        xt::xarray<double> D = xt::random::rand<double>({21, 26});
+        xt::xarray<double> E = xt::random::rand<double>({21, 26});
+        xt::xarray<int> I = xt::random::randint<int>({21, 26}, 0, 2);
+        xt::xarray<int> fmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+        xt::xarray<int> gmask = xt::random::randint<int>({21, 26}, 0, 10) < 2;
+
+        for (bool periodic : {true, false}) {
+            GooseEYE::Ensemble all({7, 10}, periodic, true);
+            GooseEYE::Ensemble a({7, 10}, periodic, true);
+            GooseEYE::Ensemble b({7, 10}, periodic, true);
+            all.S2(D, D, fmask, gmask);
+            all.S2(E, E, fmask, gmask);
+            a.S2(D, D, fmask, gmask);
+            b.S2(E, E, fmask, gmask);
+            a += b;
+            REQUIRE(xt::allclose(all.data_first(), a.data_first()));
+            REQUIRE(xt::allclose(all.data_second(), a.data_second()));
+            REQUIRE(xt::all(xt::equal(all.norm(), a.norm())));
+
+            std::stringstream stream;
+            a.save(stream);
+            GooseEYE::Ensemble c = GooseEYE::Ensemble::load(stream);
+            REQUIRE(xt::all(xt::equal(a.data_first(), c.data_first())));
+            REQUIRE(xt::all(xt::equal(a.data_second(), c.data_second())));
+            REQUIRE(xt::all(xt::equal(a.norm(), c.norm())));
+            c.S2(D, D, fmask, gmask);
+
+            // integer counters are merged exactly
+            GooseEYE::Ensemble iall({7, 10}, periodic);
+            GooseEYE::Ensemble ia({7, 10}, periodic);
+            GooseEYE::Ensemble ib({7, 10}, periodic);
+            for (auto* ensemble : {&iall, &ia, &ib}) {
+                ensemble->set_accumulator(GooseEYE::accumulator::uint32);
+            }
+            iall.C2(I, I, fmask, gmask);
+            iall.C2(I, 1 - I, fmask, gmask);
+            ia.C2(I, I, fmask, gmask);
+            ib.C2(I, 1 - I, fmask, gmask);
+            std::stringstream istream;
+            ib.save(istream);
+            ia.merge(GooseEYE::Ensemble::load(istream));
+            REQUIRE(xt::all(xt::equal(iall.data_first(), ia.data_first())));
+            REQUIRE(xt::all(xt::equal(iall.norm(), ia.norm())));
+
+            // radial bins
+            GooseEYE::Ensemble rall({7, 10}, periodic);
+            GooseEYE::Ensemble ra({7, 10}, periodic);
+            GooseEYE::Ensemble rb({7, 10}, periodic);
+            for (auto* ensemble : {&rall, &ra, &rb}) {
+                ensemble->set_radial({1.0, 1.0}, 1.0);
+            }
+            rall.S2(D, D, fmask, gmask);
+            rall.S2(E, E, fmask, gmask);
+            ra.S2(D, D, fmask, gmask);
+            rb.S2(E, E, fmask, gmask);
+            std::stringstream rstream;
+            ra.save(rstream);
+            GooseEYE::Ensemble rc = GooseEYE::Ensemble::load(rstream);
+            rc.merge(rb);
+            REQUIRE(xt::allclose(rall.result_radial(), rc.result_radial()));
+
+            // corrupted files: byte order, and bins that do not follow from the width
+            // (header: 16 bytes, roi: 24 bytes, settings: 6 bytes, "h": 32 bytes)
+            std::string bytes = rstream.str();
+            std::string swapped = bytes;
+            std::reverse(swapped.begin() + 8, swapped.begin() + 12);
+            std::stringstream sstream(swapped);
+            REQUIRE_THROWS_AS(GooseEYE::Ensemble::load(sstream), std::runtime_error);
+            for (double width : {0.0, 2.0}) {
+                std::string corrupt = bytes;
+                const char* w = reinterpret_cast<const char*>(&width);
+                corrupt.replace(78, sizeof(double), w, sizeof(double));
+                std::stringstream cstream(corrupt);
+                REQUIRE_THROWS_AS(GooseEYE::Ensemble::load(cstream), std::runtime_error);
+            }
+
+            // incompatible ensembles
+            GooseEYE::Ensemble d({7, 10}, !periodic, true);
+            REQUIRE_THROWS(a.merge(d));
+            GooseEYE::Ensemble e({7, 10}, periodic, true);
+            e.C2(I, I, fmask, gmask);
+            REQUIRE_THROWS(a.merge(e));
+        }
+    }
+
     SECTION("L - (a)")
     {
         xt::xarray<int> I = {
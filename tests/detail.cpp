@@ -60,6 +60,28 @@ TEST_CASE("GooseEYE::detail", "detail.hpp")
         REQUIRE(GooseEYE::detail::atleast_3d_axis(2, 1) == 1);
     }
 
+    SECTION("binary::pack - 2d")
+    {
+        // packed along the last axis with extent: two words per row (and one trailing word)
+        xt::xarray<int> a = xt::arange<int>(21 * 100).reshape({21, 100}) % 3 == 0;
+        auto A = xt::atleast_3d(a);
+        std::array<size_t, 3> shape = {21, 100, 1};
+        std::array<size_t, 3> roi = {7, 10, 1};
+        size_t n = GooseEYE::detail::binary::shift(shape, roi);
+        std::array<size_t, 3> rolled = GooseEYE::detail::binary::roll(shape, n);
+        auto value = [&](size_t h, size_t i, size_t j) -> bool { return A(h, i, j) != 0; };
+        auto packed = GooseEYE::detail::binary::pack(
+            rolled, GooseEYE::detail::binary::unroll(n, value));
+        REQUIRE(n == 1);
+        REQUIRE(packed.size() == 21 * 2 + 1);
+
+        for (size_t i = 0; i < 21; ++i) {
+            for (size_t j = 0; j < 100; ++j) {
+                REQUIRE(GooseEYE::detail::binary::bit(packed, rolled, 0, i, j) == (a(i, j) != 0));
+            }
+        }
+    }
+
     SECTION("atleast_3d_axis - 1d")
     {
         xt::xarray<int> a = xt::arange<int>(3).reshape({3});